@@ -0,0 +1,297 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <SDL2/SDL_image.h>
+#include <gsl/pointers>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+import DeluEngine;
+import DeluGame;
+import SDL2pp;
+import xk.Math.Angles;
+import xk.Math.Matrix;
+
+#undef main
+
+//Runs scripted scenes on a headless renderer and reports frame time percentiles
+//Scene transitions are reported the same way, timing only the frame that switches scenes
+//Must be run from the DeluCardMatch directory so the game assets resolve
+//Usage: Benchmark [frames per scene]
+
+using namespace xk::Math::Aliases;
+
+namespace
+{
+	constexpr iVector2 outputSize{ 1600, 900 };
+
+	struct BenchmarkResult
+	{
+		std::string name;
+		std::vector<std::chrono::duration<double, std::milli>> frameTimes;
+		std::vector<std::size_t> drawCalls;
+	};
+
+	struct SpriteStressSystem : public DeluEngine::SceneSystem, public DeluEngine::PulseCallback
+	{
+		std::vector<DeluEngine::UniqueSprite> sprites;
+		std::vector<Vector2> velocities;
+
+		SpriteStressSystem(const gsl::not_null<ECS::Scene*> scene, std::size_t spriteCount) :
+			SceneSystem{ scene },
+			PulseCallback{ "Game", "SpriteStressSystem" }
+		{
+			DeluEngine::Renderer& renderer = GetEngine().renderer;
+
+			//Generated so the benchmark doesn't depend on sprites.meta being present
+			auto surface = SDL2pp::CreateSurface({ 64, 64 }, SDL_PIXELFORMAT_RGBA32);
+			SDL_FillRect(surface.get(), nullptr, SDL_MapRGBA(surface.get()->format, 255, 160, 64, 255));
+			//Only the sprites keep the sheet alive past here, so it is released along with the scene
+			const DeluEngine::SpriteSheetRef sheet = renderer.AddSpriteSheet({ .texture = renderer.backend->CreateTexture(surface.get()), .rects{ SDL2pp::Rect{ 0, 0, 32, 32 }, SDL2pp::Rect{ 32, 32, 32, 32 } } });
+			const std::array spriteData
+			{
+				renderer.AddSpriteData({ .sheet = sheet.Get(), .rect = 0 }),
+				renderer.AddSpriteData({ .sheet = sheet.Get(), .rect = 1 }),
+			};
+
+			sprites.reserve(spriteCount);
+			velocities.reserve(spriteCount);
+			for(std::size_t i = 0; i < spriteCount; i++)
+			{
+				DeluEngine::UniqueSprite& sprite = sprites.emplace_back(renderer, renderer.CreateSprite(spriteData[i % spriteData.size()].Get()));
+				renderer.SetPosition(sprite.Get(), { static_cast<float>(std::rand() % outputSize.X()), static_cast<float>(std::rand() % outputSize.Y()) });
+				renderer.SetLayer(sprite.Get(), static_cast<std::int32_t>(i % 4));
+				velocities.push_back({ static_cast<float>(std::rand() % 200 - 100), static_cast<float>(std::rand() % 200 - 100) });
+			}
+		}
+
+		void Update(std::chrono::nanoseconds dt) override
+		{
+			const float deltaTime = std::chrono::duration<float>(dt).count();
+			DeluEngine::Renderer& renderer = GetEngine().renderer;
+			for(std::size_t i = 0; i < sprites.size(); i++)
+			{
+				Vector2 position = renderer.GetPosition(sprites[i].Get()) + velocities[i] * deltaTime;
+
+				//Wrap around so the on screen sprite count stays roughly constant
+				position.X() = std::fmod(position.X() + outputSize.X(), static_cast<float>(outputSize.X()));
+				position.Y() = std::fmod(position.Y() + outputSize.Y(), static_cast<float>(outputSize.Y()));
+				renderer.SetPosition(sprites[i].Get(), position);
+				renderer.SetAngle(sprites[i].Get(), renderer.GetAngle(sprites[i].Get()) + xk::Math::Degree<float>{ 90 * deltaTime });
+			}
+		}
+	};
+
+	auto SpriteStressScene(std::size_t spriteCount)
+	{
+		return [spriteCount](ECS::Scene& s)
+			{
+				s.CreateSystem<SpriteStressSystem>(spriteCount);
+			};
+	}
+
+	struct MenuStressSystem : public DeluEngine::SceneSystem, public DeluEngine::PulseCallback
+	{
+		std::vector<DeluEngine::GUI::UniqueHandle<DeluEngine::GUI::Button>> buttons;
+		std::vector<DeluEngine::GUI::UniqueHandle<DeluEngine::GUI::Text>> labels;
+		DeluEngine::Font* font = nullptr;
+		int frame = 0;
+
+		MenuStressSystem(const gsl::not_null<ECS::Scene*> scene, iVector2 gridSize) :
+			SceneSystem{ scene },
+			PulseCallback{ "Game", "MenuStressSystem" }
+		{
+			DeluEngine::Engine& engine = GetEngine();
+			DeluEngine::GUI::GUIEngine& gui = engine.guiEngine;
+			font = &engine.fonts.Get("arial.ttf", 16);
+
+			SDL2pp::shared_ptr<SDL2pp::Texture> buttonTexture;
+			{
+				SDL_Surface* surface = IMG_Load("Play_Button.png");
+				buttonTexture = engine.renderer.backend->CreateTexture(surface);
+				SDL_FreeSurface(surface);
+			}
+
+			const Vector2 cellSize{ 1.f / gridSize.X(), 1.f / gridSize.Y() };
+			for(int y = 0; y < gridSize.Y(); y++)
+			{
+				for(int x = 0; x < gridSize.X(); x++)
+				{
+					const DeluEngine::GUI::RelativePosition position{ { (x + 0.5f) * cellSize.X(), (y + 0.5f) * cellSize.Y() } };
+					buttons.push_back(gui.NewElement<DeluEngine::GUI::Button>(position, DeluEngine::GUI::RelativeSize{ cellSize * 0.9f }, { 0.5f, 0.5f }, nullptr, buttonTexture));
+					labels.push_back(gui.NewElement<DeluEngine::GUI::Text>(DeluEngine::GUI::RelativePosition{ { 0.f, 1.f } }, DeluEngine::GUI::RelativeSize{ { 1.f, 0.5f } }, { 0, 1 }, buttons.back().get()));
+					labels.back()->SetFont(font);
+					labels.back()->SetText(std::format("Item {}", buttons.size()));
+				}
+			}
+		}
+
+		void Update(std::chrono::nanoseconds dt) override
+		{
+			//Touch a handful of labels per frame like a live menu would
+			frame++;
+			for(std::size_t i = frame % 7; i < labels.size(); i += 7)
+			{
+				labels[i]->SetText(std::format("Item {} ({})", i + 1, frame));
+			}
+		}
+	};
+
+	auto MenuStressScene(iVector2 gridSize)
+	{
+		return [gridSize](ECS::Scene& s)
+			{
+				s.CreateSystem<MenuStressSystem>(gridSize);
+			};
+	}
+
+	void DrainLoads(DeluEngine::Engine& engine)
+	{
+		while(engine.assets.HasPendingLoads())
+		{
+			engine.assets.Update(engine.renderer);
+			std::this_thread::yield();
+		}
+	}
+
+	BenchmarkResult RunScene(DeluEngine::Engine& engine, std::string name, std::function<void(ECS::Scene&)> scene, int frameCount)
+	{
+		BenchmarkResult result{ .name = std::move(name) };
+		result.frameTimes.reserve(frameCount);
+		result.drawCalls.reserve(frameCount);
+
+		engine.sceneManager.LoadScene(scene);
+		engine.assets.ReleaseUnused(DeluEngine::AssetResidency::Scene);
+
+		//Loads landing inside the timed frames would be measured as part of the scene
+		DrainLoads(engine);
+
+		//Let the first frame absorb texture uploads and the initial GUI rasterization
+		DeluEngine::Tick(engine);
+		DeluEngine::Render(engine);
+
+		for(int i = 0; i < frameCount; i++)
+		{
+			engine.renderer.stats = {};
+			const auto start = std::chrono::steady_clock::now();
+			DeluEngine::Tick(engine);
+			DeluEngine::Render(engine);
+			result.frameTimes.push_back(std::chrono::steady_clock::now() - start);
+			result.drawCalls.push_back(engine.renderer.stats.drawCalls);
+		}
+
+		//Tear the scene down before the next one so its contexts and callbacks are gone
+		engine.sceneManager.LoadScene([](ECS::Scene&) {});
+		return result;
+	}
+
+	//startTransition queues or streams the next scene, the frame that switches to it is timed
+	//Each transition starts from an empty scene with nothing cached, so the new scene's loads are all requested again
+	BenchmarkResult RunTransitions(DeluEngine::Engine& engine, std::string name, std::function<void(DeluEngine::Engine&)> startTransition, int transitionCount)
+	{
+		BenchmarkResult result{ .name = std::move(name) };
+		result.frameTimes.reserve(transitionCount);
+		result.drawCalls.reserve(transitionCount);
+
+		for(int i = 0; i < transitionCount; i++)
+		{
+			engine.sceneManager.LoadScene([](ECS::Scene&) {});
+			engine.assets.ReleaseUnused(DeluEngine::AssetResidency::Scene);
+			DrainLoads(engine);
+
+			startTransition(engine);
+
+			//The old scene keeps playing while the next one prepares and its textures upload, so waiting on it isn't part of the switch
+			while(engine.sceneManager.IsStreamingScene() && !engine.sceneManager.IsStreamedSceneReady())
+			{
+				engine.assets.Update(engine.renderer);
+				std::this_thread::yield();
+			}
+
+			engine.renderer.stats = {};
+			const auto start = std::chrono::steady_clock::now();
+			DeluEngine::Tick(engine);
+			DeluEngine::Render(engine);
+			result.frameTimes.push_back(std::chrono::steady_clock::now() - start);
+			result.drawCalls.push_back(engine.renderer.stats.drawCalls);
+		}
+
+		engine.sceneManager.LoadScene([](ECS::Scene&) {});
+		DrainLoads(engine);
+		return result;
+	}
+
+	void Report(BenchmarkResult& result)
+	{
+		std::sort(result.frameTimes.begin(), result.frameTimes.end());
+		auto percentile = [&](double p)
+			{
+				const std::size_t index = static_cast<std::size_t>(p * (result.frameTimes.size() - 1));
+				return result.frameTimes[index].count();
+			};
+		const double averageDrawCalls = static_cast<double>(std::accumulate(result.drawCalls.begin(), result.drawCalls.end(), std::size_t{ 0 })) / result.drawCalls.size();
+
+		std::cout << std::format("{:<24} p50 {:>8.3f}ms  p95 {:>8.3f}ms  p99 {:>8.3f}ms  draw calls {:>8.1f}\n",
+			result.name, percentile(0.50), percentile(0.95), percentile(0.99), averageDrawCalls);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int frameCount = argc > 1 ? std::max(1, std::atoi(argv[1])) : 300;
+	std::srand(0);
+
+	DeluEngine::Engine engine
+	{
+		.renderer{ DeluEngine::OffscreenTarget{ outputSize } },
+	};
+
+	DeluEngine::gHeart.RegisterGroup("Game", 0);
+	engine.sceneManager.commonScenePreload = [](ECS::Scene& scene)
+		{
+			scene.CreateSystem<DeluEngine::SceneGUISystem>();
+			scene.CreateSystem<DeluEngine::SceneSchedulerSystem>("Game");
+		};
+	DeluEngine::Input::defaultController = &engine.controller;
+
+	engine.guiEngine.internalTexture = engine.renderer.backend->CreateTexture(
+		SDL_PIXELFORMAT_RGBA32,
+		SDL2pp::TextureAccess(SDL_TEXTUREACCESS_STATIC | SDL_TEXTUREACCESS_TARGET),
+		outputSize.X(), outputSize.Y());
+	engine.guiEngine.internalTexture->SetBlendMode(SDL_BLENDMODE_BLEND);
+
+	//Only used to register the game's controller contexts, audio isn't opened so its loads fail quietly
+	GameMain(engine);
+
+	std::vector<BenchmarkResult> results;
+	results.push_back(RunScene(engine, "Sprites 1000", SpriteStressScene(1000), frameCount));
+	results.push_back(RunScene(engine, "Sprites 10000", SpriteStressScene(10000), frameCount));
+	for(int size : { 4, 6, 8, 10 })
+	{
+		results.push_back(RunScene(engine, std::format("CardMatch {}x{}", size, size), CardMatchScene({ size, size }), frameCount));
+	}
+	results.push_back(RunScene(engine, "Menu 8x8", MenuStressScene({ 8, 8 }), frameCount));
+	results.push_back(RunScene(engine, "Menu 16x16", MenuStressScene({ 16, 16 }), frameCount));
+
+	const int transitionCount = std::max(1, frameCount / 10);
+	results.push_back(RunTransitions(engine, "Load CardMatch 6x6", [](DeluEngine::Engine& engine) { engine.queuedScene = CardMatchScene({ 6, 6 }); }, transitionCount));
+	results.push_back(RunTransitions(engine, "Stream CardMatch 6x6", [](DeluEngine::Engine& engine) { StreamCardMatchScene(engine, { 6, 6 }); }, transitionCount));
+
+	std::cout << std::format("{} frames per scene at {}x{}\n", frameCount, outputSize.X(), outputSize.Y());
+	for(BenchmarkResult& result : results)
+	{
+		Report(result);
+	}
+
+	return 0;
+}
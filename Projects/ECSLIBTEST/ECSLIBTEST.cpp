@@ -1,3 +1,15 @@
+#include "CppUnitTest.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+import ECS;
+import xk.JobSystem;
+import xk.ThreadPool;
+
 //#include "CppUnitTest.h"
 //
 //using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -674,3 +686,520 @@
 //		}
 //	};
 //}
+
+namespace ECSLIBTEST
+{
+	using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+	struct Position
+	{
+		float x;
+		float y;
+	};
+
+	struct Velocity
+	{
+		float x;
+		float y;
+	};
+
+	TEST_CLASS(RegistryTests)
+	{
+	public:
+
+		TEST_METHOD(DestroyedEntityIsNotAlive)
+		{
+			ECS::Registry registry;
+			ECS::Entity entity = registry.Create();
+			registry.Destroy(entity);
+
+			Assert::IsFalse(registry.IsAlive(entity));
+			Assert::AreEqual(std::size_t{ 0 }, registry.GetAliveCount());
+		}
+
+		TEST_METHOD(ReusedIndexGetsNewGeneration)
+		{
+			ECS::Registry registry;
+			ECS::Entity first = registry.Create();
+			registry.Destroy(first);
+			ECS::Entity second = registry.Create();
+
+			Assert::AreEqual(first.index, second.index);
+			Assert::IsFalse(first == second);
+			Assert::IsFalse(registry.IsAlive(first));
+			Assert::IsTrue(registry.IsAlive(second));
+		}
+
+		TEST_METHOD(StaleEntityDoesNotSeeNewComponents)
+		{
+			ECS::Registry registry;
+			ECS::Entity first = registry.Create();
+			registry.Destroy(first);
+			ECS::Entity second = registry.Create();
+			registry.Emplace<Position>(second, 1.f, 2.f);
+
+			Assert::IsFalse(registry.Has<Position>(first));
+			Assert::IsTrue(registry.TryGet<Position>(first) == nullptr);
+		}
+
+		TEST_METHOD(RemoveKeepsOtherComponents)
+		{
+			ECS::Registry registry;
+			std::vector<ECS::Entity> entities;
+			for(int i = 0; i < 4; i++)
+			{
+				entities.push_back(registry.Create());
+				registry.Emplace<Position>(entities.back(), static_cast<float>(i), 0.f);
+			}
+
+			registry.Remove<Position>(entities[1]);
+
+			Assert::IsFalse(registry.Has<Position>(entities[1]));
+			Assert::AreEqual(0.f, registry.Get<Position>(entities[0]).x);
+			Assert::AreEqual(2.f, registry.Get<Position>(entities[2]).x);
+			Assert::AreEqual(3.f, registry.Get<Position>(entities[3]).x);
+		}
+
+		TEST_METHOD(DestroyRemovesComponents)
+		{
+			ECS::Registry registry;
+			ECS::Entity entity = registry.Create();
+			registry.Emplace<Position>(entity, 0.f, 0.f);
+			registry.Emplace<Velocity>(entity, 0.f, 0.f);
+			registry.Destroy(entity);
+
+			Assert::AreEqual(std::size_t{ 0 }, registry.GetStorage<Position>().Size());
+			Assert::AreEqual(std::size_t{ 0 }, registry.GetStorage<Velocity>().Size());
+		}
+
+		TEST_METHOD(ViewVisitsOnlyEntitiesWithEveryComponent)
+		{
+			ECS::Registry registry;
+			ECS::Entity moving = registry.Create();
+			registry.Emplace<Position>(moving, 0.f, 0.f);
+			registry.Emplace<Velocity>(moving, 1.f, 2.f);
+
+			ECS::Entity still = registry.Create();
+			registry.Emplace<Position>(still, 5.f, 5.f);
+
+			int visited = 0;
+			registry.View<Position, Velocity>().ForEach([&](ECS::Entity entity, Position& position, Velocity& velocity)
+				{
+					Assert::IsTrue(entity == moving);
+					position.x += velocity.x;
+					position.y += velocity.y;
+					visited++;
+				});
+
+			Assert::AreEqual(1, visited);
+			Assert::AreEqual(1.f, registry.Get<Position>(moving).x);
+			Assert::AreEqual(2.f, registry.Get<Position>(moving).y);
+			Assert::AreEqual(5.f, registry.Get<Position>(still).x);
+		}
+
+		TEST_METHOD(ViewAllowsDestroyingCurrentEntity)
+		{
+			ECS::Registry registry;
+			for(int i = 0; i < 8; i++)
+			{
+				registry.Emplace<Position>(registry.Create(), static_cast<float>(i), 0.f);
+			}
+
+			int visited = 0;
+			registry.View<Position>().ForEach([&](ECS::Entity entity, Position& position)
+				{
+					visited++;
+					if(static_cast<int>(position.x) % 2 == 0)
+						registry.Destroy(entity);
+				});
+
+			Assert::AreEqual(8, visited);
+			Assert::AreEqual(std::size_t{ 4 }, registry.GetAliveCount());
+			Assert::AreEqual(std::size_t{ 4 }, registry.GetStorage<Position>().Size());
+		}
+	};
+
+	TEST_CLASS(TransformHierarchyTests)
+	{
+	public:
+
+		TEST_METHOD(ChildFollowsParentPosition)
+		{
+			ECS::TransformHierarchy hierarchy;
+			ECS::TransformHandle parent = hierarchy.Create({ 10.f, 10.f });
+			ECS::TransformHandle child = hierarchy.Create({ 5.f, 0.f }, {}, parent);
+			hierarchy.Update();
+
+			hierarchy.SetLocalPosition(parent, { 20.f, 10.f });
+			hierarchy.Update();
+
+			Assert::AreEqual(25.f, hierarchy.GetWorldPosition(child).X());
+			Assert::AreEqual(10.f, hierarchy.GetWorldPosition(child).Y());
+		}
+
+		TEST_METHOD(ChildOffsetRotatesWithParent)
+		{
+			ECS::TransformHierarchy hierarchy;
+			ECS::TransformHandle parent = hierarchy.Create({}, xk::Math::Degree<float>{ 90 });
+			ECS::TransformHandle child = hierarchy.Create({ 10.f, 0.f }, xk::Math::Degree<float>{ 10 }, parent);
+			hierarchy.Update();
+
+			Assert::AreEqual(0.f, hierarchy.GetWorldPosition(child).X(), 0.001f);
+			Assert::AreEqual(-10.f, hierarchy.GetWorldPosition(child).Y(), 0.001f);
+			Assert::AreEqual(100.f, hierarchy.GetWorldRotation(child)._value, 0.001f);
+		}
+
+		TEST_METHOD(WorldTransformIsCurrentBeforeUpdate)
+		{
+			ECS::TransformHierarchy hierarchy;
+			ECS::TransformHandle parent = hierarchy.Create({ 10.f, 0.f });
+			ECS::TransformHandle child = hierarchy.Create({ 0.f, 10.f }, {}, parent);
+
+			Assert::AreEqual(10.f, hierarchy.GetWorldPosition(child).X());
+			Assert::AreEqual(10.f, hierarchy.GetWorldPosition(child).Y());
+		}
+
+		TEST_METHOD(ReparentKeepsWorldTransform)
+		{
+			ECS::TransformHierarchy hierarchy;
+			ECS::TransformHandle first = hierarchy.Create({ 10.f, 10.f });
+			ECS::TransformHandle second = hierarchy.Create({ -5.f, 20.f });
+			ECS::TransformHandle child = hierarchy.Create({ 1.f, 1.f }, {}, first);
+			hierarchy.Update();
+
+			hierarchy.SetParent(child, second);
+			hierarchy.Update();
+
+			Assert::IsTrue(hierarchy.GetParent(child) == second);
+			Assert::AreEqual(11.f, hierarchy.GetWorldPosition(child).X(), 0.001f);
+			Assert::AreEqual(11.f, hierarchy.GetWorldPosition(child).Y(), 0.001f);
+		}
+
+		TEST_METHOD(ReparentKeepsLocalTransform)
+		{
+			ECS::TransformHierarchy hierarchy;
+			ECS::TransformHandle first = hierarchy.Create({ 10.f, 10.f });
+			ECS::TransformHandle second = hierarchy.Create({ -5.f, 20.f });
+			ECS::TransformHandle child = hierarchy.Create({ 1.f, 1.f }, {}, first);
+
+			hierarchy.SetParent(child, second, ECS::ReparentLogic::KeepLocalTransform);
+			hierarchy.Update();
+
+			Assert::AreEqual(-4.f, hierarchy.GetWorldPosition(child).X());
+			Assert::AreEqual(21.f, hierarchy.GetWorldPosition(child).Y());
+		}
+
+		TEST_METHOD(CyclicParentingThrows)
+		{
+			ECS::TransformHierarchy hierarchy;
+			ECS::TransformHandle t1 = hierarchy.Create();
+			ECS::TransformHandle t2 = hierarchy.Create({}, {}, t1);
+			ECS::TransformHandle t3 = hierarchy.Create({}, {}, t2);
+
+			Assert::ExpectException<std::logic_error>([&] { hierarchy.SetParent(t1, t3); });
+			Assert::ExpectException<std::logic_error>([&] { hierarchy.SetParent(t1, t1); });
+		}
+
+		TEST_METHOD(DestroyMovesChildrenUp)
+		{
+			ECS::TransformHierarchy hierarchy;
+			ECS::TransformHandle root = hierarchy.Create({ 10.f, 0.f });
+			ECS::TransformHandle middle = hierarchy.Create({ 10.f, 0.f }, {}, root);
+			ECS::TransformHandle leaf = hierarchy.Create({ 10.f, 0.f }, {}, middle);
+			hierarchy.Update();
+
+			hierarchy.Destroy(middle);
+			hierarchy.Update();
+
+			Assert::IsFalse(hierarchy.IsAlive(middle));
+			Assert::IsTrue(hierarchy.GetParent(leaf) == root);
+			Assert::AreEqual(20.f, hierarchy.GetWorldPosition(leaf).X());
+		}
+	};
+
+	struct RecordingSystem : public ECS::ScheduledSystem
+	{
+		std::vector<int>& log;
+		int id;
+
+		RecordingSystem(ECS::SystemScheduler& scheduler, ECS::SystemAccess access, std::vector<int>& log, int id) :
+			ScheduledSystem{ scheduler, std::move(access), "RecordingSystem" },
+			log{ log },
+			id{ id }
+		{
+
+		}
+
+		void Execute(std::chrono::nanoseconds) override
+		{
+			log.push_back(id);
+		}
+	};
+
+	struct ThrowingSystem : public ECS::ScheduledSystem
+	{
+		using ScheduledSystem::ScheduledSystem;
+
+		void Execute(std::chrono::nanoseconds) override
+		{
+			throw std::runtime_error("System failed");
+		}
+	};
+
+	TEST_CLASS(SchedulerTests)
+	{
+	public:
+
+		TEST_METHOD(AccessConflicts)
+		{
+			Assert::IsFalse(ECS::SystemAccess{}.Read<Position>().ConflictsWith(ECS::SystemAccess{}.Read<Position>()));
+			Assert::IsFalse(ECS::SystemAccess{}.Write<Position>().ConflictsWith(ECS::SystemAccess{}.Write<Velocity>()));
+			Assert::IsTrue(ECS::SystemAccess{}.Read<Position>().ConflictsWith(ECS::SystemAccess{}.Write<Position>()));
+			Assert::IsTrue(ECS::SystemAccess{}.Write<Position>().ConflictsWith(ECS::SystemAccess{}.Write<Position, Velocity>()));
+			Assert::IsFalse(ECS::SystemAccess{}.WriteResource<Position>().ConflictsWith(ECS::SystemAccess{}.Write<Position>()));
+			Assert::IsTrue(ECS::SystemAccess{}.ReadResource<Position>().ConflictsWith(ECS::SystemAccess{}.WriteResource<Position>()));
+			Assert::IsTrue(ECS::SystemAccess{}.Exclusive().ConflictsWith(ECS::SystemAccess{}));
+		}
+
+		TEST_METHOD(RunsInRegistrationOrderWithoutJobSystem)
+		{
+			ECS::Registry registry;
+			ECS::SystemScheduler scheduler{ registry };
+			std::vector<int> log;
+			RecordingSystem first{ scheduler, ECS::SystemAccess{}.Read<Position>(), log, 0 };
+			RecordingSystem second{ scheduler, ECS::SystemAccess{}.Read<Velocity>(), log, 1 };
+			RecordingSystem third{ scheduler, ECS::SystemAccess{}.Read<Position>(), log, 2 };
+
+			scheduler.Run(std::chrono::milliseconds{ 16 });
+
+			Assert::IsTrue(log == std::vector<int>{ 0, 1, 2 });
+		}
+
+		TEST_METHOD(ConflictingSystemsRunInRegistrationOrder)
+		{
+			xk::JobSystem jobSystem{ 4 };
+			ECS::Registry registry;
+			ECS::SystemScheduler scheduler{ registry };
+
+			//Every recording system writes Position, so they never touch log at the same time
+			std::vector<int> log;
+			std::vector<int> unused;
+			RecordingSystem first{ scheduler, ECS::SystemAccess{}.Write<Position>(), log, 0 };
+			RecordingSystem reader{ scheduler, ECS::SystemAccess{}.Read<Velocity>(), unused, 0 };
+			RecordingSystem second{ scheduler, ECS::SystemAccess{}.Write<Position>().Read<Velocity>(), log, 1 };
+			RecordingSystem third{ scheduler, ECS::SystemAccess{}.Write<Position>(), log, 2 };
+
+			for(int frame = 0; frame < 100; frame++)
+			{
+				log.clear();
+				scheduler.Run(std::chrono::milliseconds{ 16 }, &jobSystem);
+				Assert::IsTrue(log == std::vector<int>{ 0, 1, 2 });
+			}
+		}
+
+		TEST_METHOD(DestroyedSystemIsUnregistered)
+		{
+			ECS::Registry registry;
+			ECS::SystemScheduler scheduler{ registry };
+			std::vector<int> log;
+			RecordingSystem kept{ scheduler, ECS::SystemAccess{}.Write<Position>(), log, 0 };
+			{
+				RecordingSystem removed{ scheduler, ECS::SystemAccess{}.Write<Position>(), log, 1 };
+			}
+
+			xk::JobSystem jobSystem{ 2 };
+			scheduler.Run(std::chrono::milliseconds{ 16 }, &jobSystem);
+
+			Assert::AreEqual(std::size_t{ 1 }, scheduler.GetSystemCount());
+			Assert::IsTrue(log == std::vector<int>{ 0 });
+		}
+
+		TEST_METHOD(SystemExceptionIsRethrown)
+		{
+			xk::JobSystem jobSystem{ 2 };
+			ECS::Registry registry;
+			ECS::SystemScheduler scheduler{ registry };
+			std::vector<int> log;
+			ThrowingSystem failing{ scheduler, ECS::SystemAccess{}.Write<Position>(), "ThrowingSystem" };
+			RecordingSystem dependent{ scheduler, ECS::SystemAccess{}.Read<Position>(), log, 0 };
+
+			Assert::ExpectException<std::runtime_error>([&] { scheduler.Run(std::chrono::milliseconds{ 16 }, &jobSystem); });
+			Assert::IsTrue(log.empty());
+		}
+	};
+
+	TEST_CLASS(ThreadPoolTests)
+	{
+	public:
+
+		TEST_METHOD(DestructionRunsQueuedTasks)
+		{
+			std::atomic<int> runCount = 0;
+			{
+				xk::ThreadPool threadPool{ 1 };
+				for(int i = 0; i < 100; i++)
+				{
+					threadPool.Post([&] { runCount++; });
+				}
+			}
+			Assert::AreEqual(100, runCount.load());
+		}
+
+		TEST_METHOD(DestructionWithoutWorkersRunsQueuedTasks)
+		{
+			int runCount = 0;
+			{
+				xk::ThreadPool threadPool{ 0 };
+				threadPool.Post([&] { runCount++; threadPool.Post([&] { runCount++; }); });
+			}
+			Assert::AreEqual(2, runCount);
+		}
+	};
+
+	TEST_CLASS(SceneStreamingTests)
+	{
+		struct DestructionRecorder : ECS::SceneSystem
+		{
+			std::thread::id* destroyedOn;
+
+			DestructionRecorder(ECS::Scene* scene, std::thread::id& destroyedOn) :
+				SceneSystem{ scene },
+				destroyedOn{ &destroyedOn }
+			{
+
+			}
+
+			~DestructionRecorder()
+			{
+				*destroyedOn = std::this_thread::get_id();
+			}
+		};
+
+	public:
+
+		TEST_METHOD(StreamedSceneIsSwappedInOnceReady)
+		{
+			int externalSystem = 0;
+			xk::ThreadPool threadPool{ 1 };
+			ECS::SceneManager sceneManager{ externalSystem };
+			sceneManager.LoadScene([](ECS::Scene& scene) { scene.GetRegistry().Create(); });
+
+			bool initialized = false;
+			sceneManager.StreamScene(threadPool,
+				[](ECS::Scene& scene)
+				{
+					for(int i = 0; i < 3; i++)
+					{
+						scene.GetRegistry().Create();
+					}
+				},
+				[&](ECS::Scene& scene)
+				{
+					initialized = true;
+					Assert::AreEqual(std::size_t{ 3 }, scene.GetRegistry().GetAliveCount());
+				});
+
+			Assert::IsTrue(sceneManager.IsStreamingScene());
+			while(!sceneManager.IsStreamedSceneReady())
+			{
+				std::this_thread::yield();
+			}
+			Assert::IsFalse(initialized);
+
+			sceneManager.SwapStreamedScene();
+			Assert::IsTrue(initialized);
+			Assert::IsFalse(sceneManager.IsStreamingScene());
+		}
+
+		TEST_METHOD(FailedPrepareIsRethrownOnSwap)
+		{
+			int externalSystem = 0;
+			xk::ThreadPool threadPool{ 1 };
+			ECS::SceneManager sceneManager{ externalSystem };
+
+			bool initialized = false;
+			sceneManager.StreamScene(threadPool,
+				[](ECS::Scene&) { throw std::runtime_error("Prepare failed"); },
+				[&](ECS::Scene&) { initialized = true; });
+
+			while(!sceneManager.IsStreamedSceneReady())
+			{
+				std::this_thread::yield();
+			}
+
+			Assert::ExpectException<std::runtime_error>([&] { sceneManager.SwapStreamedScene(); });
+			Assert::IsFalse(initialized);
+			Assert::IsFalse(sceneManager.IsStreamingScene());
+		}
+
+		TEST_METHOD(SwapWithoutStreamedSceneThrows)
+		{
+			int externalSystem = 0;
+			ECS::SceneManager sceneManager{ externalSystem };
+
+			Assert::ExpectException<std::logic_error>([&] { sceneManager.SwapStreamedScene(); });
+		}
+
+		TEST_METHOD(StreamedSceneWaitsForReadiness)
+		{
+			int externalSystem = 0;
+			xk::ThreadPool threadPool{ 1 };
+			ECS::SceneManager sceneManager{ externalSystem };
+
+			std::atomic<bool> prepared = false;
+			bool assetsLoaded = false;
+			sceneManager.StreamScene(threadPool,
+				[&](ECS::Scene&) { prepared = true; },
+				[&] { return assetsLoaded; },
+				[](ECS::Scene&) {});
+
+			while(!prepared)
+			{
+				std::this_thread::yield();
+			}
+			threadPool.Submit([] {}).wait();
+			Assert::IsFalse(sceneManager.IsStreamedSceneReady());
+
+			assetsLoaded = true;
+			Assert::IsTrue(sceneManager.IsStreamedSceneReady());
+			sceneManager.SwapStreamedScene();
+			Assert::IsFalse(sceneManager.IsStreamingScene());
+		}
+
+		TEST_METHOD(FailedPrepareSkipsReadiness)
+		{
+			int externalSystem = 0;
+			xk::ThreadPool threadPool{ 1 };
+			ECS::SceneManager sceneManager{ externalSystem };
+
+			sceneManager.StreamScene(threadPool,
+				[](ECS::Scene&) { throw std::runtime_error("Prepare failed"); },
+				[] { return false; },
+				[](ECS::Scene&) {});
+
+			while(!sceneManager.IsStreamedSceneReady())
+			{
+				std::this_thread::yield();
+			}
+			Assert::ExpectException<std::runtime_error>([&] { sceneManager.SwapStreamedScene(); });
+		}
+
+		TEST_METHOD(OldSceneIsDestroyedOnSwappingThread)
+		{
+			int externalSystem = 0;
+			xk::ThreadPool threadPool{ 1 };
+			ECS::SceneManager sceneManager{ externalSystem };
+
+			std::thread::id destroyedOn;
+			sceneManager.LoadScene([&](ECS::Scene& scene) { scene.CreateSystem<DestructionRecorder>(destroyedOn); });
+			sceneManager.StreamScene(threadPool, [](ECS::Scene&) {}, [](ECS::Scene&) {});
+			while(!sceneManager.IsStreamedSceneReady())
+			{
+				std::this_thread::yield();
+			}
+
+			sceneManager.SwapStreamedScene();
+			Assert::IsTrue(destroyedOn == std::this_thread::get_id());
+		}
+	};
+}
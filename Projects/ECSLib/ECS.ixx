@@ -14,6 +14,10 @@ module;
 #include <iostream>
 #include <type_traits>
 #include <optional>
+#include <chrono>
+#include <future>
+#include <concepts>
+#include "ProfilerMacros.h"
 
 export module ECS;
 export import xk.Math.Matrix;
@@ -21,6 +25,11 @@ export import xk.Math.Angles;
 import xk.ScopeGuard;
 import xk.FunctionPointers;
 import xk.AnyPtr;
+import xk.Profiler;
+import xk.ThreadPool;
+export import :Registry;
+export import :Transform;
+export import :Scheduler;
 
 //
 //////Object template
@@ -1124,7 +1133,13 @@ namespace ECS
 	export class Scene final
 	{
 	private:
+		//Declared before the systems so components and the scheduler outlive systems that refer to them
+		Registry m_registry;
+		SystemScheduler m_scheduler{ m_registry };
 		std::vector<std::unique_ptr<SceneSystem>> m_systems;
+
+		//Indexed by xk::TypeIndex<SceneSystem>, the first system created of each type
+		std::vector<SceneSystem*> m_systemsByType;
 		gsl::not_null<SceneManager*> m_sceneManager;
 
 	public:
@@ -1134,23 +1149,60 @@ namespace ECS
 
 		}
 
+		Scene(const Scene&) = delete;
+		Scene& operator=(const Scene&) = delete;
+
+		~Scene()
+		{
+			DestroySystems();
+		}
+
 		template<std::derived_from<SceneSystem> Ty, class... ConstructorParams>
 		Ty& CreateSystem(ConstructorParams&&... params)
 		{
 			m_systems.push_back(std::make_unique<Ty>(this, std::forward<ConstructorParams>(params)...));
+
+			const std::size_t typeIndex = xk::TypeIndex<SceneSystem>::Of<Ty>();
+			if(typeIndex >= m_systemsByType.size())
+				m_systemsByType.resize(typeIndex + 1);
+			if(!m_systemsByType[typeIndex])
+				m_systemsByType[typeIndex] = m_systems.back().get();
 			return static_cast<Ty&>(*m_systems.back());
 		}
 
+		//Matches the exact type the system was created as, not its bases
 		template<std::derived_from<SceneSystem> Ty>
 		Ty& GetSystem() const
 		{
-			auto it = std::find_if(m_systems.begin(), m_systems.end(), [](const auto& value) { return typeid(*value) == typeid(Ty); });
-			if(it == m_systems.end())
-				throw std::exception("No matching system found");
-			return static_cast<Ty&>(*(*it));
+			if(Ty* system = TryGetSystem<Ty>())
+				return *system;
+			throw std::out_of_range("No matching system found");
+		}
+
+		template<std::derived_from<SceneSystem> Ty>
+		Ty* TryGetSystem() const noexcept
+		{
+			const std::size_t typeIndex = xk::TypeIndex<SceneSystem>::Of<Ty>();
+			return typeIndex < m_systemsByType.size() ? static_cast<Ty*>(m_systemsByType[typeIndex]) : nullptr;
 		}
 
 		xk::AnyRef GetExternalSystem() const;
+
+		Registry& GetRegistry() noexcept { return m_registry; }
+		const Registry& GetRegistry() const noexcept { return m_registry; }
+
+		SystemScheduler& GetScheduler() noexcept { return m_scheduler; }
+
+	private:
+		//Newest first as later systems may refer to earlier ones
+		void DestroySystems() noexcept
+		{
+			m_systemsByType.clear();
+			while(!m_systems.empty())
+			{
+				m_systems.pop_back();
+			}
+		}
 	};
 
 	export class SceneManager final
@@ -1159,6 +1211,15 @@ namespace ECS
 		xk::AnyRef m_externalSystem;
 		std::unique_ptr<Scene> m_scene;
 
+		//The next scene while its prepare step runs on a thread pool, swapped in by SwapStreamedScene
+		std::unique_ptr<Scene> m_streamedScene;
+		std::function<void(Scene&)> m_streamedInit;
+		std::function<bool()> m_streamedIsReady;
+		std::future<void> m_streamedPrepare;
+
+		//Written by the worker before m_streamedPrepare becomes ready, false if prepare threw
+		bool m_streamedPrepared = false;
+
 	public:
 		//Likely some temp thing
 		std::function<void(Scene&)> commonScenePreload;
@@ -1171,19 +1232,100 @@ namespace ECS
 
 		}
 
+		SceneManager(const SceneManager&) = delete;
+		SceneManager& operator=(const SceneManager&) = delete;
+
+		//The streamed scene is still being written to by a worker
+		~SceneManager()
+		{
+			if(m_streamedPrepare.valid())
+				m_streamedPrepare.wait();
+		}
+
 		template<std::invocable<Scene&> InitFunc>
 		void LoadScene(InitFunc func)
 		{
+			XK_PROFILE_ZONE("SceneManager::LoadScene");
 			m_scene = std::make_unique<Scene>(this);
 			if(commonScenePreload)
 				commonScenePreload(*m_scene);
 			func(*m_scene);
 		}
 
+		//Builds the next scene while the current one keeps running, prepare runs on threadPool and init on this thread once it is swapped in
+		//prepare may only touch the scene it is given and services documented as thread safe, anything shared with the running scene belongs in init
+		//A scene that is still streaming is waited for and discarded
+		template<std::invocable<Scene&> PrepareFunc, std::invocable<Scene&> InitFunc>
+		void StreamScene(xk::ThreadPool& threadPool, PrepareFunc prepare, InitFunc init)
+		{
+			StreamScene(threadPool, std::move(prepare), [] { return true; }, std::move(init));
+		}
+
+		//Keeps the current scene running until isReady also holds, such as until the assets prepare requested have loaded
+		//isReady is polled on this thread and only once prepare has finished without throwing
+		template<std::invocable<Scene&> PrepareFunc, std::predicate ReadyFunc, std::invocable<Scene&> InitFunc>
+		void StreamScene(xk::ThreadPool& threadPool, PrepareFunc prepare, ReadyFunc isReady, InitFunc init)
+		{
+			DiscardStreamedScene();
+			m_streamedScene = std::make_unique<Scene>(this);
+			m_streamedInit = std::move(init);
+			m_streamedIsReady = std::move(isReady);
+			m_streamedPrepared = false;
+			m_streamedPrepare = threadPool.Submit([this, scene = m_streamedScene.get(), prepare = std::move(prepare)]() mutable
+				{
+					XK_PROFILE_ZONE("SceneManager::PrepareScene");
+					prepare(*scene);
+					m_streamedPrepared = true;
+				});
+		}
+
+		bool IsStreamingScene() const noexcept { return m_streamedScene != nullptr; }
+
+		//A failed prepare counts as ready so SwapStreamedScene can rethrow it
+		bool IsStreamedSceneReady() const
+		{
+			if(!m_streamedPrepare.valid() || m_streamedPrepare.wait_for(std::chrono::seconds{ 0 }) != std::future_status::ready)
+				return false;
+			return !m_streamedPrepared || m_streamedIsReady();
+		}
+
+		//Meant to be called between frames
+		//The old scene is destroyed here, on the calling thread, as its systems and components may own game thread resources
+		//Rethrows whatever prepare threw, in which case the current scene is kept
+		void SwapStreamedScene()
+		{
+			if(!IsStreamedSceneReady())
+				throw std::logic_error("No streamed scene is ready");
+
+			XK_PROFILE_ZONE("SceneManager::SwapStreamedScene");
+			std::unique_ptr<Scene> scene = std::move(m_streamedScene);
+			std::function<void(Scene&)> init = std::exchange(m_streamedInit, nullptr);
+			m_streamedIsReady = nullptr;
+			std::exchange(m_streamedPrepare, {}).get();
+
+			m_scene = std::move(scene);
+			if(commonScenePreload)
+				commonScenePreload(*m_scene);
+			init(*m_scene);
+		}
+
 		xk::AnyRef GetExternalSystem() const
 		{
 			return m_externalSystem;
 		}
+
+	private:
+		void DiscardStreamedScene()
+		{
+			if(!m_streamedScene)
+				return;
+
+			m_streamedPrepare.wait();
+			m_streamedPrepare = {};
+			m_streamedInit = nullptr;
+			m_streamedIsReady = nullptr;
+			m_streamedScene = nullptr;
+		}
 	};
 
 	xk::AnyRef Scene::GetExternalSystem() const
@@ -0,0 +1,295 @@
+module;
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+export module ECS:Registry;
+import xk.AnyPtr;
+
+namespace ECS
+{
+	//An index into the registry and the generation it had when created
+	//Destroying an entity bumps the generation, so stale copies are no longer alive rather than aliasing the next entity
+	export struct Entity
+	{
+		std::uint32_t index = std::numeric_limits<std::uint32_t>::max();
+		std::uint32_t generation = 0;
+
+		friend bool operator==(const Entity&, const Entity&) = default;
+	};
+
+	export inline constexpr Entity nullEntity{};
+
+	//Entities and their dense positions for one component type
+	//The sparse array maps an entity index to its position in the packed arrays, which hold no gaps
+	class SparseSet
+	{
+	protected:
+		static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+		std::vector<std::uint32_t> m_sparse;
+		std::vector<Entity> m_dense;
+
+	public:
+		virtual ~SparseSet() = default;
+
+		bool Contains(Entity entity) const noexcept
+		{
+			return entity.index < m_sparse.size() && m_sparse[entity.index] != none && m_dense[m_sparse[entity.index]] == entity;
+		}
+
+		std::size_t Size() const noexcept { return m_dense.size(); }
+		std::span<const Entity> GetEntities() const noexcept { return m_dense; }
+
+		//Moves the last component into the removed one's place
+		virtual void Remove(Entity entity) = 0;
+
+	protected:
+		std::uint32_t DenseIndex(Entity entity) const noexcept { return m_sparse[entity.index]; }
+
+		void AddEntity(Entity entity)
+		{
+			if(entity.index >= m_sparse.size())
+				m_sparse.resize(entity.index + 1, none);
+			m_sparse[entity.index] = static_cast<std::uint32_t>(m_dense.size());
+			m_dense.push_back(entity);
+		}
+
+		//Returns the dense index that was freed
+		std::uint32_t RemoveEntity(Entity entity) noexcept
+		{
+			const std::uint32_t index = m_sparse[entity.index];
+			const Entity last = m_dense.back();
+			m_dense[index] = last;
+			m_sparse[last.index] = index;
+			m_dense.pop_back();
+			m_sparse[entity.index] = none;
+			return index;
+		}
+	};
+
+	export template<class Ty>
+	class ComponentStorage final : public SparseSet
+	{
+	private:
+		std::vector<Ty> m_components;
+
+	public:
+		template<class... Args>
+		Ty& Emplace(Entity entity, Args&&... args)
+		{
+			if(Contains(entity))
+				throw std::logic_error("Entity already has this component");
+
+			if constexpr(std::is_aggregate_v<Ty>)
+				m_components.push_back(Ty{ std::forward<Args>(args)... });
+			else
+				m_components.emplace_back(std::forward<Args>(args)...);
+			AddEntity(entity);
+			return m_components.back();
+		}
+
+		void Remove(Entity entity) override
+		{
+			const std::uint32_t index = RemoveEntity(entity);
+			if(index != m_components.size() - 1)
+				m_components[index] = std::move(m_components.back());
+			m_components.pop_back();
+		}
+
+		Ty& Get(Entity entity) noexcept { return m_components[DenseIndex(entity)]; }
+		const Ty& Get(Entity entity) const noexcept { return m_components[DenseIndex(entity)]; }
+
+		//Same order as GetEntities
+		std::span<Ty> GetComponents() noexcept { return m_components; }
+		std::span<const Ty> GetComponents() const noexcept { return m_components; }
+	};
+
+	export class Registry;
+
+	//Entities that have every one of Tys, valid for as long as the registry it came from
+	export template<class... Tys>
+	class View
+	{
+	private:
+		std::tuple<ComponentStorage<Tys>*...> m_storages;
+
+	public:
+		explicit View(ComponentStorage<Tys>&... storages) :
+			m_storages{ &storages... }
+		{
+
+		}
+
+		//Calls func(entity, components...) for each match
+		//Iterates the smallest storage back to front, so func may remove components of or destroy the entity it was given
+		template<std::invocable<Entity, Tys&...> Func>
+		void ForEach(Func func)
+		{
+			if constexpr(sizeof...(Tys) == 1)
+			{
+				//Entities and components sit at the same dense index, no lookups needed
+				auto& storage = *std::get<0>(m_storages);
+				for(std::size_t i = storage.Size(); i-- > 0;)
+				{
+					func(storage.GetEntities()[i], storage.GetComponents()[i]);
+				}
+			}
+			else
+			{
+				const SparseSet* smallest = nullptr;
+				std::apply([&](auto*... storages) { ((smallest = !smallest || storages->Size() < smallest->Size() ? storages : smallest), ...); }, m_storages);
+
+				const std::span<const Entity> entities = smallest->GetEntities();
+				for(std::size_t i = entities.size(); i-- > 0;)
+				{
+					//Copied out as func may remove it from the span
+					const Entity entity = smallest->GetEntities()[i];
+					if(std::apply([entity](auto*... storages) { return (storages->Contains(entity) && ...); }, m_storages))
+						std::apply([&](auto*... storages) { func(entity, storages->Get(entity)...); }, m_storages);
+				}
+			}
+		}
+
+		//Upper bound on how many entities ForEach will visit
+		std::size_t SizeHint() const noexcept
+		{
+			return std::apply([](auto*... storages) { return std::min({ storages->Size()... }); }, m_storages);
+		}
+	};
+
+	//Owns entities and their components, each component type in its own packed storage
+	export class Registry
+	{
+	private:
+		static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+		//Generation of every index ever handed out, freed indices are chained through m_nextFree
+		std::vector<std::uint32_t> m_generations;
+		std::vector<std::uint32_t> m_nextFree;
+		std::uint32_t m_freeIndex = none;
+		std::size_t m_aliveCount = 0;
+
+		//Indexed by xk::TypeIndex<SparseSet>, null for types this registry hasn't seen
+		std::vector<std::unique_ptr<SparseSet>> m_storages;
+
+	public:
+		Registry() = default;
+		Registry(const Registry&) = delete;
+		Registry& operator=(const Registry&) = delete;
+
+		Entity Create()
+		{
+			m_aliveCount++;
+			if(m_freeIndex != none)
+			{
+				const std::uint32_t index = std::exchange(m_freeIndex, m_nextFree[m_freeIndex]);
+				return { index, m_generations[index] };
+			}
+
+			m_generations.push_back(0);
+			m_nextFree.push_back(none);
+			return { static_cast<std::uint32_t>(m_generations.size() - 1), 0 };
+		}
+
+		void Destroy(Entity entity)
+		{
+			if(!IsAlive(entity))
+				throw std::out_of_range("Entity is not alive");
+
+			for(const std::unique_ptr<SparseSet>& storage : m_storages)
+			{
+				if(storage && storage->Contains(entity))
+					storage->Remove(entity);
+			}
+
+			m_generations[entity.index]++;
+			m_nextFree[entity.index] = m_freeIndex;
+			m_freeIndex = entity.index;
+			m_aliveCount--;
+		}
+
+		bool IsAlive(Entity entity) const noexcept
+		{
+			//Destroying bumps the generation, so a free index never matches a handle that was handed out
+			return entity.index < m_generations.size() && m_generations[entity.index] == entity.generation;
+		}
+
+		std::size_t GetAliveCount() const noexcept { return m_aliveCount; }
+
+		template<class Ty, class... Args>
+		Ty& Emplace(Entity entity, Args&&... args)
+		{
+			if(!IsAlive(entity))
+				throw std::out_of_range("Entity is not alive");
+			return GetStorage<Ty>().Emplace(entity, std::forward<Args>(args)...);
+		}
+
+		template<class Ty>
+		void Remove(Entity entity)
+		{
+			ComponentStorage<Ty>& storage = GetStorage<Ty>();
+			if(!storage.Contains(entity))
+				throw std::out_of_range("Entity does not have this component");
+			storage.Remove(entity);
+		}
+
+		template<class Ty>
+		bool Has(Entity entity) const noexcept
+		{
+			const ComponentStorage<Ty>* storage = FindStorage<Ty>();
+			return storage && storage->Contains(entity);
+		}
+
+		template<class Ty>
+		Ty& Get(Entity entity)
+		{
+			if(Ty* component = TryGet<Ty>(entity))
+				return *component;
+			throw std::out_of_range("Entity does not have this component");
+		}
+
+		template<class Ty>
+		Ty* TryGet(Entity entity) noexcept
+		{
+			ComponentStorage<Ty>* storage = FindStorage<Ty>();
+			return storage && storage->Contains(entity) ? &storage->Get(entity) : nullptr;
+		}
+
+		template<class... Tys>
+			requires (sizeof...(Tys) > 0)
+		ECS::View<Tys...> View()
+		{
+			return ECS::View<Tys...>{ GetStorage<Tys>()... };
+		}
+
+		template<class Ty>
+		ComponentStorage<Ty>& GetStorage()
+		{
+			const std::size_t typeIndex = xk::TypeIndex<SparseSet>::Of<Ty>();
+			if(typeIndex >= m_storages.size())
+				m_storages.resize(typeIndex + 1);
+			if(!m_storages[typeIndex])
+				m_storages[typeIndex] = std::make_unique<ComponentStorage<Ty>>();
+			return static_cast<ComponentStorage<Ty>&>(*m_storages[typeIndex]);
+		}
+
+	private:
+		template<class Ty>
+		ComponentStorage<Ty>* FindStorage() const noexcept
+		{
+			const std::size_t typeIndex = xk::TypeIndex<SparseSet>::Of<Ty>();
+			return typeIndex < m_storages.size() ? static_cast<ComponentStorage<Ty>*>(m_storages[typeIndex].get()) : nullptr;
+		}
+	};
+}
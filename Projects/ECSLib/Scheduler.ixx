@@ -0,0 +1,290 @@
+module;
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "ProfilerMacros.h"
+
+export module ECS:Scheduler;
+import :Registry;
+import xk.AnyPtr;
+import xk.JobSystem;
+import xk.Profiler;
+import xk.ScopeGuard;
+
+namespace ECS
+{
+	//What a scheduled system touches, systems whose accesses don't conflict may run at the same time
+	//Writing a component also covers adding and removing it, creating or destroying entities needs Exclusive
+	export class SystemAccess
+	{
+	private:
+		//Components use the registry's storage indices, resources are any other type systems agree on
+		std::vector<std::size_t> m_componentReads;
+		std::vector<std::size_t> m_componentWrites;
+		std::vector<std::size_t> m_resourceReads;
+		std::vector<std::size_t> m_resourceWrites;
+
+		//Creates the storages up front, so running systems only ever look them up
+		std::vector<void(*)(Registry&)> m_storageInits;
+		bool m_exclusive = false;
+
+	public:
+		template<class... Tys>
+		SystemAccess& Read()
+		{
+			(AddComponent<Tys>(m_componentReads), ...);
+			return *this;
+		}
+
+		template<class... Tys>
+		SystemAccess& Write()
+		{
+			(AddComponent<Tys>(m_componentWrites), ...);
+			return *this;
+		}
+
+		template<class... Tys>
+		SystemAccess& ReadResource()
+		{
+			(Add(m_resourceReads, xk::TypeIndex<SystemAccess>::Of<Tys>()), ...);
+			return *this;
+		}
+
+		template<class... Tys>
+		SystemAccess& WriteResource()
+		{
+			(Add(m_resourceWrites, xk::TypeIndex<SystemAccess>::Of<Tys>()), ...);
+			return *this;
+		}
+
+		//Runs alone, after every system registered before it and before every system registered after it
+		SystemAccess& Exclusive() noexcept
+		{
+			m_exclusive = true;
+			return *this;
+		}
+
+		bool ConflictsWith(const SystemAccess& other) const noexcept
+		{
+			return m_exclusive || other.m_exclusive
+				|| Intersects(m_componentWrites, other.m_componentReads) || Intersects(m_componentWrites, other.m_componentWrites)
+				|| Intersects(m_componentReads, other.m_componentWrites)
+				|| Intersects(m_resourceWrites, other.m_resourceReads) || Intersects(m_resourceWrites, other.m_resourceWrites)
+				|| Intersects(m_resourceReads, other.m_resourceWrites);
+		}
+
+		void PrepareStorages(Registry& registry) const
+		{
+			for(void(*init)(Registry&) : m_storageInits)
+			{
+				init(registry);
+			}
+		}
+
+	private:
+		template<class Ty>
+		void AddComponent(std::vector<std::size_t>& set)
+		{
+			Add(set, xk::TypeIndex<SparseSet>::Of<Ty>());
+			m_storageInits.push_back([](Registry& registry) { registry.GetStorage<Ty>(); });
+		}
+
+		//Sets are kept sorted so conflicts are a linear merge
+		static void Add(std::vector<std::size_t>& set, std::size_t index)
+		{
+			auto it = std::lower_bound(set.begin(), set.end(), index);
+			if(it == set.end() || *it != index)
+				set.insert(it, index);
+		}
+
+		static bool Intersects(const std::vector<std::size_t>& lhs, const std::vector<std::size_t>& rhs) noexcept
+		{
+			auto left = lhs.begin();
+			auto right = rhs.begin();
+			while(left != lhs.end() && right != rhs.end())
+			{
+				if(*left < *right)
+					++left;
+				else if(*right < *left)
+					++right;
+				else
+					return true;
+			}
+			return false;
+		}
+	};
+
+	export class SystemScheduler;
+
+	//A system the scheduler runs each frame, registers itself for as long as it lives
+	export class ScheduledSystem
+	{
+	private:
+		SystemScheduler* m_scheduler;
+
+	public:
+		//name labels the system in profiler traces and must outlive the profiler
+		ScheduledSystem(SystemScheduler& scheduler, SystemAccess access, const char* name);
+		ScheduledSystem(const ScheduledSystem&) = delete;
+		ScheduledSystem& operator=(const ScheduledSystem&) = delete;
+
+		//May run on any thread, at the same time as systems it doesn't conflict with
+		virtual void Execute(std::chrono::nanoseconds deltaTime) = 0;
+
+	protected:
+		~ScheduledSystem();
+	};
+
+	//Runs scheduled systems with every conflicting pair ordered by registration, and the rest concurrently
+	//Systems must not be registered or destroyed from inside Run
+	export class SystemScheduler
+	{
+		friend class ScheduledSystem;
+
+	private:
+		struct Node
+		{
+			ScheduledSystem* system;
+			const char* name;
+			SystemAccess access;
+			std::vector<std::uint32_t> dependents;
+			std::uint32_t dependencyCount = 0;
+		};
+
+		Registry* m_registry;
+		std::vector<Node> m_nodes;
+		std::unique_ptr<std::atomic<std::uint32_t>[]> m_remaining;
+		bool m_graphDirty = false;
+		bool m_running = false;
+
+	public:
+		explicit SystemScheduler(Registry& registry) :
+			m_registry{ &registry }
+		{
+
+		}
+
+		SystemScheduler(const SystemScheduler&) = delete;
+		SystemScheduler& operator=(const SystemScheduler&) = delete;
+
+		~SystemScheduler()
+		{
+			assert(m_nodes.empty());
+		}
+
+		std::size_t GetSystemCount() const noexcept { return m_nodes.size(); }
+
+		//Without a job system every system runs on the calling thread in registration order
+		//The first exception a system throws is rethrown once the systems already running finish, its dependents are skipped
+		void Run(std::chrono::nanoseconds deltaTime, xk::JobSystem* jobSystem = nullptr)
+		{
+			assert(!m_running);
+			m_running = true;
+			xk::ScopeExit resetRunning{ [this] { m_running = false; } };
+
+			if(!jobSystem || m_nodes.size() < 2)
+			{
+				for(const Node& node : m_nodes)
+				{
+					Execute(node, deltaTime);
+				}
+				return;
+			}
+
+			if(m_graphDirty)
+				BuildGraph();
+
+			for(std::size_t i = 0; i < m_nodes.size(); i++)
+			{
+				m_remaining[i].store(m_nodes[i].dependencyCount, std::memory_order_relaxed);
+			}
+
+			xk::JobCounter counter;
+			for(std::size_t i = 0; i < m_nodes.size(); i++)
+			{
+				if(m_nodes[i].dependencyCount == 0)
+					Launch(static_cast<std::uint32_t>(i), deltaTime, *jobSystem, counter);
+			}
+			jobSystem->Wait(counter);
+		}
+
+	private:
+		void Add(ScheduledSystem& system, SystemAccess access, const char* name)
+		{
+			assert(!m_running);
+			access.PrepareStorages(*m_registry);
+			m_nodes.push_back({ &system, name, std::move(access) });
+			m_graphDirty = true;
+		}
+
+		void Remove(ScheduledSystem& system) noexcept
+		{
+			assert(!m_running);
+			std::erase_if(m_nodes, [&system](const Node& node) { return node.system == &system; });
+			m_graphDirty = true;
+		}
+
+		//Each system waits on every earlier one it conflicts with, registration order is already a valid order to run them in
+		void BuildGraph()
+		{
+			for(Node& node : m_nodes)
+			{
+				node.dependents.clear();
+				node.dependencyCount = 0;
+			}
+
+			for(std::size_t later = 1; later < m_nodes.size(); later++)
+			{
+				for(std::size_t earlier = 0; earlier < later; earlier++)
+				{
+					if(m_nodes[earlier].access.ConflictsWith(m_nodes[later].access))
+					{
+						m_nodes[earlier].dependents.push_back(static_cast<std::uint32_t>(later));
+						m_nodes[later].dependencyCount++;
+					}
+				}
+			}
+
+			m_remaining = std::make_unique<std::atomic<std::uint32_t>[]>(m_nodes.size());
+			m_graphDirty = false;
+		}
+
+		//The last dependency to finish starts its dependent, so no thread ever waits on a particular system
+		void Launch(std::uint32_t index, std::chrono::nanoseconds deltaTime, xk::JobSystem& jobSystem, xk::JobCounter& counter)
+		{
+			jobSystem.Run(counter, [this, index, deltaTime, &jobSystem, &counter]
+				{
+					const Node& node = m_nodes[index];
+					Execute(node, deltaTime);
+					for(std::uint32_t dependent : node.dependents)
+					{
+						if(m_remaining[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+							Launch(dependent, deltaTime, jobSystem, counter);
+					}
+				});
+		}
+
+		static void Execute(const Node& node, std::chrono::nanoseconds deltaTime)
+		{
+			XK_PROFILE_ZONE(node.name);
+			node.system->Execute(deltaTime);
+		}
+	};
+
+	ScheduledSystem::ScheduledSystem(SystemScheduler& scheduler, SystemAccess access, const char* name) :
+		m_scheduler{ &scheduler }
+	{
+		m_scheduler->Add(*this, std::move(access), name);
+	}
+
+	ScheduledSystem::~ScheduledSystem()
+	{
+		m_scheduler->Remove(*this);
+	}
+}
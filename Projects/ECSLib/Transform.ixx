@@ -0,0 +1,428 @@
+module;
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+export module ECS:Transform;
+import xk.Math.Matrix;
+import xk.Math.Angles;
+import xk.JobSystem;
+
+namespace ECS
+{
+	export enum class ReparentLogic
+	{
+		KeepWorldTransform,
+		KeepLocalTransform
+	};
+
+	export struct TransformHandle
+	{
+		std::uint32_t id = std::numeric_limits<std::uint32_t>::max();
+		std::uint32_t generation = 0;
+
+		friend bool operator==(const TransformHandle&, const TransformHandle&) = default;
+	};
+
+	//2D transforms stored as parallel arrays sorted by depth, so every parent comes before its children
+	//World transforms are recomputed in one sweep in that order, touching only nodes whose local transform or an ancestor's changed
+	//A child's local position is rotated by its parent's world rotation, rotations are clockwise like sprite angles
+	export class TransformHierarchy
+	{
+	private:
+		using Vector2 = xk::Math::Aliases::Vector2;
+		using Angle = xk::Math::Degree<float>;
+
+		static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+		//Levels smaller than this run on the calling thread, splitting them costs more than it saves
+		static constexpr std::size_t parallelChunkSize = 4096;
+
+		//Per id, stable for the life of a handle
+		std::vector<std::uint32_t> m_generations;
+		std::vector<std::uint32_t> m_denseIndices;
+		std::vector<std::uint32_t> m_childCounts;
+		std::vector<std::uint32_t> m_freeIds;
+
+		//Per dense index, destroyed nodes keep their slot with id none until the next update compacts them out
+		std::vector<std::uint32_t> m_ids;
+		std::vector<std::uint32_t> m_parentIds;
+		std::vector<std::uint32_t> m_parents;
+		std::vector<std::uint32_t> m_depths;
+		std::vector<Vector2> m_localPositions;
+		std::vector<Angle> m_localRotations;
+		std::vector<Vector2> m_worldPositions;
+		std::vector<Angle> m_worldRotations;
+		std::vector<std::uint8_t> m_dirty;
+
+		//First dense index of each depth
+		std::vector<std::size_t> m_levelStarts;
+
+		std::size_t m_destroyedCount = 0;
+		bool m_orderDirty = false;
+		bool m_anyDirty = false;
+
+	public:
+		TransformHandle Create(Vector2 localPosition = {}, Angle localRotation = {}, TransformHandle parent = {})
+		{
+			const std::uint32_t parentId = parent == TransformHandle{} ? none : CheckedId(parent);
+
+			std::uint32_t id;
+			if(!m_freeIds.empty())
+			{
+				id = m_freeIds.back();
+				m_freeIds.pop_back();
+			}
+			else
+			{
+				id = static_cast<std::uint32_t>(m_generations.size());
+				m_generations.push_back(0);
+				m_denseIndices.push_back(none);
+				m_childCounts.push_back(0);
+			}
+
+			const std::uint32_t depth = parentId == none ? 0 : m_depths[m_denseIndices[parentId]] + 1;
+			const auto index = static_cast<std::uint32_t>(m_ids.size());
+
+			//Appending keeps the order as long as nothing deeper is already at the end
+			if(!m_depths.empty() && depth < m_depths.back())
+			{
+				m_orderDirty = true;
+			}
+			else
+			{
+				while(m_levelStarts.size() <= depth)
+				{
+					m_levelStarts.push_back(index);
+				}
+			}
+
+			m_denseIndices[id] = index;
+			m_ids.push_back(id);
+			m_parentIds.push_back(parentId);
+			m_parents.push_back(parentId == none ? none : m_denseIndices[parentId]);
+			m_depths.push_back(depth);
+			m_localPositions.push_back(localPosition);
+			m_localRotations.push_back(localRotation);
+			m_worldPositions.push_back({});
+			m_worldRotations.push_back({});
+			m_dirty.push_back(1);
+			m_anyDirty = true;
+			if(parentId != none)
+				m_childCounts[parentId]++;
+
+			return { id, m_generations[id] };
+		}
+
+		//Children move up to the destroyed node's parent keeping their local transforms
+		void Destroy(TransformHandle handle)
+		{
+			const std::uint32_t id = CheckedId(handle);
+			const std::uint32_t index = m_denseIndices[id];
+			const std::uint32_t parentId = m_parentIds[index];
+
+			if(m_childCounts[id] > 0)
+			{
+				for(std::size_t i = 0; i < m_parentIds.size(); i++)
+				{
+					if(m_parentIds[i] != id || m_ids[i] == none)
+						continue;
+
+					m_parentIds[i] = parentId;
+					m_dirty[i] = 1;
+					if(parentId != none)
+						m_childCounts[parentId]++;
+				}
+				m_orderDirty = true;
+				m_anyDirty = true;
+			}
+
+			if(parentId != none)
+				m_childCounts[parentId]--;
+
+			m_ids[index] = none;
+			m_parentIds[index] = none;
+			m_denseIndices[id] = none;
+			m_childCounts[id] = 0;
+			m_generations[id]++;
+			m_freeIds.push_back(id);
+			m_destroyedCount++;
+		}
+
+		bool IsAlive(TransformHandle handle) const noexcept
+		{
+			return handle.id < m_generations.size() && m_generations[handle.id] == handle.generation;
+		}
+
+		void SetParent(TransformHandle child, TransformHandle parent, ReparentLogic logic = ReparentLogic::KeepWorldTransform)
+		{
+			const std::uint32_t childId = CheckedId(child);
+			const std::uint32_t parentId = parent == TransformHandle{} ? none : CheckedId(parent);
+			if(childId == parentId)
+				throw std::logic_error("Cannot parent to yourself");
+
+			for(std::uint32_t ancestor = parentId; ancestor != none; ancestor = m_parentIds[m_denseIndices[ancestor]])
+			{
+				if(ancestor == childId)
+					throw std::logic_error("Cyclic parenting detected and is not allowed");
+			}
+
+			const std::uint32_t index = m_denseIndices[childId];
+			const auto [worldPosition, worldRotation] = ComputeWorld(index);
+
+			if(m_parentIds[index] != none)
+				m_childCounts[m_parentIds[index]]--;
+			m_parentIds[index] = parentId;
+			if(parentId != none)
+				m_childCounts[parentId]++;
+
+			m_orderDirty = true;
+			MarkDirty(index);
+
+			if(logic == ReparentLogic::KeepWorldTransform)
+				SetWorld(index, worldPosition, worldRotation);
+		}
+
+		TransformHandle GetParent(TransformHandle handle) const
+		{
+			const std::uint32_t parentId = m_parentIds[m_denseIndices[CheckedId(handle)]];
+			return parentId == none ? TransformHandle{} : TransformHandle{ parentId, m_generations[parentId] };
+		}
+
+		Vector2 GetLocalPosition(TransformHandle handle) const { return m_localPositions[DenseIndex(handle)]; }
+		Angle GetLocalRotation(TransformHandle handle) const { return m_localRotations[DenseIndex(handle)]; }
+
+		void SetLocalPosition(TransformHandle handle, Vector2 position)
+		{
+			const std::uint32_t index = DenseIndex(handle);
+			m_localPositions[index] = position;
+			MarkDirty(index);
+		}
+
+		void SetLocalRotation(TransformHandle handle, Angle rotation)
+		{
+			const std::uint32_t index = DenseIndex(handle);
+			m_localRotations[index] = rotation;
+			MarkDirty(index);
+		}
+
+		//Resolved through the parents if anything changed since the last update, so it is current between updates too
+		Vector2 GetWorldPosition(TransformHandle handle) const { return ComputeWorld(DenseIndex(handle)).first; }
+		Angle GetWorldRotation(TransformHandle handle) const { return ComputeWorld(DenseIndex(handle)).second; }
+
+		void SetWorldPosition(TransformHandle handle, Vector2 position)
+		{
+			const std::uint32_t index = DenseIndex(handle);
+			SetWorld(index, position, ComputeWorld(index).second);
+		}
+
+		void SetWorldRotation(TransformHandle handle, Angle rotation)
+		{
+			const std::uint32_t index = DenseIndex(handle);
+			SetWorld(index, ComputeWorld(index).first, rotation);
+		}
+
+		//Brings every world transform up to date
+		//With a job system, depths wide enough to be worth splitting are updated in parallel chunks
+		void Update(xk::JobSystem* jobSystem = nullptr)
+		{
+			if(m_orderDirty || m_destroyedCount > 0)
+				Rebuild();
+
+			if(!m_anyDirty)
+				return;
+
+			for(std::size_t level = 0; level < m_levelStarts.size(); level++)
+			{
+				const std::size_t begin = m_levelStarts[level];
+				const std::size_t end = level + 1 < m_levelStarts.size() ? m_levelStarts[level + 1] : m_ids.size();
+				if(!jobSystem || end - begin < parallelChunkSize * 2)
+				{
+					UpdateRange(begin, end);
+					continue;
+				}
+
+				//Nodes of one depth only read the depth above, which is already done
+				xk::JobCounter counter;
+				for(std::size_t chunk = begin; chunk < end; chunk += parallelChunkSize)
+				{
+					jobSystem->Run(counter, [this, chunk, end] { UpdateRange(chunk, std::min(chunk + parallelChunkSize, end)); });
+				}
+				jobSystem->Wait(counter);
+			}
+
+			std::fill(m_dirty.begin(), m_dirty.end(), std::uint8_t{ 0 });
+			m_anyDirty = false;
+		}
+
+		//World transforms in update order as of the last Update, for systems that consume all of them at once
+		std::span<const Vector2> GetWorldPositions() const noexcept { return m_worldPositions; }
+		std::span<const Angle> GetWorldRotations() const noexcept { return m_worldRotations; }
+
+		//Position of handle in the spans above, changes whenever nodes are destroyed or reparented
+		std::uint32_t GetUpdateIndex(TransformHandle handle) const { return DenseIndex(handle); }
+
+	private:
+		std::uint32_t CheckedId(TransformHandle handle) const
+		{
+			if(!IsAlive(handle))
+				throw std::out_of_range("Transform is not alive");
+			return handle.id;
+		}
+
+		std::uint32_t DenseIndex(TransformHandle handle) const
+		{
+			return m_denseIndices[CheckedId(handle)];
+		}
+
+		void MarkDirty(std::uint32_t index) noexcept
+		{
+			m_dirty[index] = 1;
+			m_anyDirty = true;
+		}
+
+		static Vector2 Rotate(Vector2 position, Angle rotation) noexcept
+		{
+			const float radians = rotation._value * std::numbers::pi_v<float> / 180.f;
+			const float cosAngle = std::cos(radians);
+			const float sinAngle = std::sin(radians);
+			return { position.X() * cosAngle + position.Y() * sinAngle, position.Y() * cosAngle - position.X() * sinAngle };
+		}
+
+		//Walks up through parents by id, so it works before the order has been rebuilt
+		std::pair<Vector2, Angle> ComputeWorld(std::uint32_t index) const
+		{
+			if(!m_anyDirty && !m_orderDirty)
+				return { m_worldPositions[index], m_worldRotations[index] };
+
+			const std::uint32_t parentId = m_parentIds[index];
+			if(parentId == none)
+				return { m_localPositions[index], m_localRotations[index] };
+
+			const auto [parentPosition, parentRotation] = ComputeWorld(m_denseIndices[parentId]);
+			return { parentPosition + Rotate(m_localPositions[index], parentRotation), parentRotation + m_localRotations[index] };
+		}
+
+		void SetWorld(std::uint32_t index, Vector2 position, Angle rotation)
+		{
+			const std::uint32_t parentId = m_parentIds[index];
+			if(parentId == none)
+			{
+				m_localPositions[index] = position;
+				m_localRotations[index] = rotation;
+			}
+			else
+			{
+				const auto [parentPosition, parentRotation] = ComputeWorld(m_denseIndices[parentId]);
+				m_localPositions[index] = Rotate(position - parentPosition, Angle{ -parentRotation._value });
+				m_localRotations[index] = rotation - parentRotation;
+			}
+			MarkDirty(index);
+		}
+
+		void UpdateRange(std::size_t begin, std::size_t end) noexcept
+		{
+			for(std::size_t i = begin; i < end; i++)
+			{
+				const std::uint32_t parent = m_parents[i];
+				if(parent == none)
+				{
+					if(m_dirty[i])
+					{
+						m_worldPositions[i] = m_localPositions[i];
+						m_worldRotations[i] = m_localRotations[i];
+					}
+					continue;
+				}
+
+				if(!m_dirty[i] && !m_dirty[parent])
+					continue;
+
+				m_worldPositions[i] = m_worldPositions[parent] + Rotate(m_localPositions[i], m_worldRotations[parent]);
+				m_worldRotations[i] = m_worldRotations[parent] + m_localRotations[i];
+
+				//Lets the next depth see that this branch changed
+				m_dirty[i] = 1;
+			}
+		}
+
+		//Drops destroyed slots and, when the hierarchy changed shape, re-sorts by depth
+		void Rebuild()
+		{
+			std::vector<std::uint32_t> order;
+			order.reserve(m_ids.size() - m_destroyedCount);
+			for(std::uint32_t i = 0; i < m_ids.size(); i++)
+			{
+				if(m_ids[i] != none)
+					order.push_back(i);
+			}
+
+			if(m_orderDirty)
+			{
+				//Depths by id, parents are resolved on demand as the current order may have them after their children
+				std::vector<std::uint32_t> depths(m_generations.size(), none);
+				auto depthOf = [&](auto& self, std::uint32_t id) -> std::uint32_t
+					{
+						if(depths[id] != none)
+							return depths[id];
+
+						const std::uint32_t parentId = m_parentIds[m_denseIndices[id]];
+						return depths[id] = parentId == none ? 0 : self(self, parentId) + 1;
+					};
+
+				for(std::uint32_t index : order)
+				{
+					m_depths[index] = depthOf(depthOf, m_ids[index]);
+				}
+				std::stable_sort(order.begin(), order.end(), [this](std::uint32_t lh, std::uint32_t rh) { return m_depths[lh] < m_depths[rh]; });
+			}
+
+			auto permute = [&order](auto& values)
+				{
+					std::remove_reference_t<decltype(values)> sorted;
+					sorted.reserve(order.size());
+					for(std::uint32_t index : order)
+					{
+						sorted.push_back(values[index]);
+					}
+					values = std::move(sorted);
+				};
+
+			permute(m_ids);
+			permute(m_parentIds);
+			permute(m_depths);
+			permute(m_localPositions);
+			permute(m_localRotations);
+			permute(m_worldPositions);
+			permute(m_worldRotations);
+			permute(m_dirty);
+
+			m_parents.resize(m_ids.size());
+			m_levelStarts.clear();
+			for(std::uint32_t i = 0; i < m_ids.size(); i++)
+			{
+				m_denseIndices[m_ids[i]] = i;
+				while(m_levelStarts.size() <= m_depths[i])
+				{
+					m_levelStarts.push_back(i);
+				}
+			}
+			for(std::uint32_t i = 0; i < m_ids.size(); i++)
+			{
+				m_parents[i] = m_parentIds[i] == none ? none : m_denseIndices[m_parentIds[i]];
+			}
+
+			m_destroyedCount = 0;
+			m_orderDirty = false;
+		}
+	};
+}
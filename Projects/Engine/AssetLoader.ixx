@@ -0,0 +1,264 @@
+module;
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+export module DeluEngine:AssetLoader;
+import :Renderer;
+import SDL2pp;
+import xk.Math.Matrix;
+import xk.ThreadPool;
+
+namespace DeluEngine
+{
+	export class AssetLoader;
+
+	//How long a cached asset stays around once nothing references it
+	export enum class AssetResidency
+	{
+		//Released on the next scene change
+		Scene,
+
+		//Kept until explicitly released, for assets every scene is likely to need again
+		Persistent
+	};
+
+	//Handle to a texture being decoded on a worker and uploaded on the game thread
+	//Continuations registered through a handle are dropped once it and all its copies are gone
+	export class AsyncTexture
+	{
+		friend class AssetLoader;
+
+	private:
+		struct Continuation
+		{
+			std::weak_ptr<const void> owner;
+			std::function<void(const AsyncTexture&)> func;
+		};
+
+		struct State
+		{
+			std::string path;
+			SDL2pp::shared_ptr<SDL2pp::Texture> texture;
+			xk::Math::Aliases::iVector2 size;
+			bool loaded = false;
+			bool failed = false;
+
+			//Only touched on the game thread
+			std::vector<Continuation> continuations;
+		};
+
+		std::shared_ptr<State> m_state;
+
+		//Shared between copies of one request, separate requests for a cached asset get their own
+		std::shared_ptr<const void> m_owner;
+
+	public:
+		AsyncTexture() noexcept = default;
+
+		bool IsLoaded() const noexcept { return m_state && m_state->loaded; }
+		bool IsFailed() const noexcept { return m_state && m_state->failed; }
+
+		//Null until loaded
+		SDL2pp::shared_ptr<SDL2pp::Texture> Get() const { return m_state ? m_state->texture : nullptr; }
+
+		//Pixel size of the image, valid once loaded
+		xk::Math::Aliases::iVector2 GetSize() const noexcept { return m_state ? m_state->size : xk::Math::Aliases::iVector2{}; }
+
+		//Runs func on the game thread once the texture is uploaded, immediately if it already is
+		void Then(std::function<void(const AsyncTexture&)> func) const
+		{
+			if(!m_state || m_state->failed)
+				return;
+
+			if(m_state->loaded)
+				func(*this);
+			else
+				m_state->continuations.push_back({ m_owner, std::move(func) });
+		}
+
+		explicit operator bool() const noexcept { return static_cast<bool>(m_state); }
+		friend bool operator==(const AsyncTexture& lh, const AsyncTexture& rh) noexcept { return lh.m_state == rh.m_state; }
+	};
+
+	//Decodes images on a thread pool, uploads are done from Update so they can be spread across frames
+	//Textures are cached by path, repeated loads of a cached path share the texture and do no I/O
+	//LoadTexture without a continuation may be called from any thread, everything else is game thread only
+	export class AssetLoader
+	{
+	private:
+		struct DecodedSurface
+		{
+			std::weak_ptr<AsyncTexture::State> state;
+			SDL2pp::unique_ptr<SDL2pp::Surface> surface;
+		};
+
+		struct CacheEntry
+		{
+			std::shared_ptr<AsyncTexture::State> state;
+			AssetResidency residency;
+		};
+
+		xk::ThreadPool* m_threadPool;
+
+		//Also guards the failed flag of cached states, which decides whether a load is retried
+		std::mutex m_cacheMutex;
+		std::unordered_map<std::string, CacheEntry> m_textureCache;
+
+		std::mutex m_decodedMutex;
+		std::vector<DecodedSurface> m_decoded;
+
+		//Loads posted to the pool that haven't reached m_decoded yet
+		std::atomic<std::size_t> m_decoding{ 0 };
+
+		//Game thread copy of m_decoded so the lock isn't held while uploading
+		std::vector<DecodedSurface> m_pendingUploads;
+
+	public:
+		//Time Update may spend creating textures, at least one upload happens per call regardless
+		std::chrono::microseconds uploadBudget{ 2000 };
+
+	public:
+		AssetLoader(xk::ThreadPool& threadPool) :
+			m_threadPool(&threadPool)
+		{
+
+		}
+
+		AsyncTexture LoadTexture(std::string path, AssetResidency residency = AssetResidency::Scene)
+		{
+			AsyncTexture texture;
+			texture.m_owner = std::make_shared<char>();
+
+			std::scoped_lock lock{ m_cacheMutex };
+			auto [it, inserted] = m_textureCache.try_emplace(path, CacheEntry{ nullptr, residency });
+			it->second.residency = std::max(it->second.residency, residency);
+			if(!inserted && !it->second.state->failed)
+			{
+				texture.m_state = it->second.state;
+				return texture;
+			}
+
+			it->second.state = std::make_shared<AsyncTexture::State>();
+			it->second.state->path = std::move(path);
+			texture.m_state = it->second.state;
+
+			m_decoding.fetch_add(1, std::memory_order_relaxed);
+			m_threadPool->Post([this, weakState = std::weak_ptr{ texture.m_state }]
+				{
+					std::string path;
+					{
+						std::shared_ptr state = weakState.lock();
+						if(!state)
+						{
+							m_decoding.fetch_sub(1, std::memory_order_release);
+							return;
+						}
+						path = state->path;
+					}
+
+					SDL2pp::unique_ptr<SDL2pp::Surface> surface = IMG_Load(path.c_str());
+					std::scoped_lock lock{ m_decodedMutex };
+					m_decoded.push_back({ weakState, std::move(surface) });
+					m_decoding.fetch_sub(1, std::memory_order_release);
+				});
+
+			return texture;
+		}
+
+		AsyncTexture LoadTexture(std::string path, AssetResidency residency, std::function<void(const AsyncTexture&)> onLoaded)
+		{
+			AsyncTexture texture = LoadTexture(std::move(path), residency);
+			texture.Then(std::move(onLoaded));
+			return texture;
+		}
+
+		//Drops cached assets at or below residency that no handle refers to anymore
+		void ReleaseUnused(AssetResidency residency)
+		{
+			std::scoped_lock lock{ m_cacheMutex };
+			std::erase_if(m_textureCache, [residency](const auto& entry)
+				{
+					return entry.second.residency <= residency && entry.second.state.use_count() == 1;
+				});
+		}
+
+		//Includes loads still being decoded, not just ones waiting to be uploaded
+		bool HasPendingLoads()
+		{
+			std::scoped_lock lock{ m_decodedMutex };
+			return m_decoding.load(std::memory_order_acquire) > 0 || !m_decoded.empty() || !m_pendingUploads.empty();
+		}
+
+		//Uploads decoded images until the budget runs out and runs their continuations
+		void Update(Renderer& renderer)
+		{
+			{
+				std::scoped_lock lock{ m_decodedMutex };
+				std::move(m_decoded.begin(), m_decoded.end(), std::back_inserter(m_pendingUploads));
+				m_decoded.clear();
+			}
+
+			if(m_pendingUploads.empty())
+				return;
+
+			const auto start = std::chrono::steady_clock::now();
+			std::size_t uploaded = 0;
+			while(uploaded < m_pendingUploads.size())
+			{
+				DecodedSurface& decoded = m_pendingUploads[uploaded++];
+				Upload(renderer, decoded);
+
+				if(std::chrono::steady_clock::now() - start >= uploadBudget)
+					break;
+			}
+			m_pendingUploads.erase(m_pendingUploads.begin(), m_pendingUploads.begin() + uploaded);
+		}
+
+	private:
+		void Upload(Renderer& renderer, DecodedSurface& decoded)
+		{
+			std::shared_ptr state = decoded.state.lock();
+			if(!state)
+				return;
+
+			if(!decoded.surface)
+			{
+				{
+					std::scoped_lock lock{ m_cacheMutex };
+					state->failed = true;
+				}
+				state->continuations.clear();
+				return;
+			}
+
+			state->size = { decoded.surface.get()->w, decoded.surface.get()->h };
+			state->texture = renderer.backend->CreateTexture(decoded.surface.get());
+			state->loaded = true;
+			decoded.surface = nullptr;
+
+			AsyncTexture texture;
+			texture.m_state = state;
+			for(auto& continuation : std::exchange(state->continuations, {}))
+			{
+				std::shared_ptr owner = continuation.owner.lock();
+				if(!owner)
+					continue;
+
+				texture.m_owner = std::move(owner);
+				continuation.func(texture);
+			}
+		}
+	};
+}
@@ -1,4 +1,4 @@
-module DeluEngine:SpriteComponent;
+module DeluEngine;
 import :Engine;
 
 namespace DeluEngine
@@ -6,7 +6,7 @@ namespace DeluEngine
 	//SpriteObject::SpriteObject(const ECS::ObjectInitializer& initializer, const ECS::UserGameObjectInitializer& goInitializer, ConstructorParams params) :
 	//	//SceneAware(initializer.scene),
 	//	GameObject(initializer, goInitializer),
-	//	m_spriteHandle(GetEngine().renderer.CreateSprite(params.sprite))
+	//	m_sprite(GetEngine().renderer, GetEngine().renderer.CreateSprite(params.sprite))
 	//{
 
 	//}
@@ -15,11 +15,11 @@ namespace DeluEngine
 	//public:
 	//	struct ConstructorParams
 	//	{
-	//		std::shared_ptr<SpriteData> sprite = nullptr;
+	//		SpriteDataIndex sprite = Renderer::defaultSpriteData;
 	//	};
 
 	//private:
-	//	SpriteHandle m_spriteHandle;
+	//	UniqueSprite m_sprite;
 
 	//public:
 	//	using ObjectBaseClasses = ECS::ObjectBaseClassesHelper<DeluEngine::GameObject>;
@@ -30,8 +30,8 @@ namespace DeluEngine
 	//public:
 	//	void Update(float deltaTime) override
 	//	{
-	//		m_spriteHandle->position = Transform().Position();
-	//		m_spriteHandle->angle = static_cast<xk::Math::Degree<float>>(Transform().Rotation());
+	//		GetEngine().renderer.SetPosition(m_sprite.Get(), Transform().Position());
+	//		GetEngine().renderer.SetAngle(m_sprite.Get(), static_cast<xk::Math::Degree<float>>(Transform().Rotation()));
 	//	}
 	//};
 }
\ No newline at end of file
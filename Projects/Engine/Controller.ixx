@@ -79,7 +79,8 @@ namespace DeluEngine
 		Up,
 		Down,
 
-		Escape
+		Escape,
+		F12
 	};
 
 	std::pair<Key, KeyState> MapKey(const SDL_KeyboardEvent& event)
@@ -203,6 +204,9 @@ namespace DeluEngine
 		case SDLK_ESCAPE:
 			key = Escape;
 			break;
+		case SDLK_F12:
+			key = F12;
+			break;
 
 		default:
 			key = Temp_None;
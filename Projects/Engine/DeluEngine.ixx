@@ -8,3 +8,6 @@ export import :SpriteComponent;
 //export import :Physics;
 export import :GUI;
 export import :Heart;
+export import :TimerWheel;
+export import :AssetLoader;
+export import :Font;
@@ -1,9 +1,10 @@
 module;
 
+#include <chrono>
 #include <gsl/pointers>
 #include <vector>
 
-module DeluEngine:ECS;
+module DeluEngine;
 import ECS;
 import :Engine;
 
@@ -14,6 +15,11 @@ namespace DeluEngine
 		m_systemOwnedElements.clear();
 	}
 
+	void SceneSchedulerSystem::Update(std::chrono::nanoseconds deltaTime)
+	{
+		GetScene().GetScheduler().Run(deltaTime, &GetEngine().jobSystem);
+	}
+
 	Engine& GetEngine(const ECS::Scene& scene)
 	{
 		return scene.GetExternalSystem().As<Engine>();
@@ -7,12 +7,15 @@ module;
 #include <gsl/pointers>
 #include <assert.h>
 #include <any>
+#include <chrono>
+#include <string_view>
 
 export module DeluEngine:ECS;
 export import ECS;
 import :ForwardDeclares;
 import :EngineAware;
 import :GUI;
+import :Heart;
 import SDL2pp;
 
 namespace DeluEngine
@@ -53,17 +56,22 @@ namespace DeluEngine
 
 	export class SceneSystem : public ECS::SceneSystem
 	{
+	private:
+		//Resolved once as the scene's engine can't change, systems ask for it every frame
+		gsl::not_null<Engine*> m_engine;
+
 	public:		
 		SceneSystem(const gsl::not_null<ECS::Scene*> scene) :
-			ECS::SceneSystem{ scene }
+			ECS::SceneSystem{ scene },
+			m_engine{ &DeluEngine::GetEngine(*scene) }
 		{
 
 		}
 
 	public:
-		Engine& GetEngine() const
+		Engine& GetEngine() const noexcept
 		{
-			return DeluEngine::GetEngine(GetScene());
+			return *m_engine;
 		}
 	};
 
@@ -88,6 +96,20 @@ namespace DeluEngine
 		}
 	};
 
+	//Runs the scene's scheduled systems as part of a pulse group, spread over the engine's job system
+	export class SceneSchedulerSystem : public SceneSystem, public PulseCallback
+	{
+	public:
+		SceneSchedulerSystem(const gsl::not_null<ECS::Scene*> scene, std::string_view groupName) :
+			SceneSystem{ scene },
+			PulseCallback{ groupName, "SceneSchedulerSystem" }
+		{
+
+		}
+
+		void Update(std::chrono::nanoseconds deltaTime) override;
+	};
+
 	//Scene& GameObject::GetScene() const noexcept
 	//{
 	//	return static_cast<Scene&>(ECS::GameObject::GetScene());
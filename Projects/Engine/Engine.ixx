@@ -2,11 +2,14 @@ module;
 
 #include <gsl/pointers>
 #include <memory>
+#include <concepts>
 #include <SDL2/SDL.h>
 #include <array>
 #include <iostream>
 #include <numbers>
 #include <functional>
+#include <optional>
+#include "ProfilerMacros.h"
 
 export module DeluEngine:Engine;
 import :Renderer;
@@ -15,8 +18,14 @@ import :Controller;
 //import :Physics;
 import :ForwardDeclares;
 import :GUI;
+import :Heart;
+import :AssetLoader;
+import :Font;
 import SDL2pp;
 import xk.Math.Matrix;
+import xk.ThreadPool;
+import xk.JobSystem;
+import xk.Profiler;
 
 namespace DeluEngine
 {
@@ -82,15 +91,39 @@ namespace DeluEngine
 	{
 		SDL2pp::unique_ptr<SDL2pp::Window> window;
 		Renderer renderer;
+
+		//Declared after the renderer so atlas textures are destroyed before it
+		FontCache fonts;
 		Controller controller;
 		Experimental::ControllerContextManager controllerContext;
 		GUI::GUIEngine guiEngine;
+
+		//The pool is declared after the loader so its workers are joined before the loader goes away
+		AssetLoader assets{ threadPool };
+		xk::ThreadPool threadPool;
+
+		//Runs concurrent pulse groups, separate from the pool so long asset loads can't hold up a frame
+		xk::JobSystem jobSystem;
 		//b2World physicsWorld{ {0, -9.8f } };
 		//Box2DCallbacks box2DCallbacks;
 		std::function<void(ECS::Scene&)> queuedScene;
 		ECS::SceneManager sceneManager{ *this };
 		bool running = true;
 
+		//Builds the scene while the current one keeps running, prepare runs on the thread pool and Tick swaps the scene in between frames
+		//Only pays off when prepare does the heavy lifting, such as requesting the scene's assets
+		template<std::invocable<ECS::Scene&> PrepareFunc, std::invocable<ECS::Scene&> InitFunc>
+		void StreamScene(PrepareFunc prepare, InitFunc init)
+		{
+			sceneManager.StreamScene(threadPool, std::move(prepare), std::move(init));
+		}
+
+		//Also keeps the current scene until isReady holds, Tick polls it once prepare has finished
+		template<std::invocable<ECS::Scene&> PrepareFunc, std::predicate ReadyFunc, std::invocable<ECS::Scene&> InitFunc>
+		void StreamScene(PrepareFunc prepare, ReadyFunc isReady, InitFunc init)
+		{
+			sceneManager.StreamScene(threadPool, std::move(prepare), std::move(isReady), std::move(init));
+		}
 
 		void ProcessEvent(const SDL2pp::Event& event)
 		{
@@ -104,6 +137,107 @@ namespace DeluEngine
 		}
 	};
 
+	//Drains the whole event queue, consecutive mouse motion is collapsed into the latest position
+	//so a flood of motion events costs one dispatch instead of one frame each
+	export void PumpEvents(Engine& engine)
+	{
+		const xk::Math::Aliases::Vector2 outputSize = engine.renderer.backend->GetOutputSize();
+		auto dispatch = [&](const SDL2pp::Event& event)
+			{
+				GUI::ProcessEvent(engine.guiEngine, event, outputSize);
+				engine.ProcessEvent(event);
+			};
+
+		std::optional<SDL2pp::Event> pendingMotion;
+		SDL2pp::Event event;
+		while(SDL2pp::PollEvent(event))
+		{
+			if(event.type == SDL2pp::EventType::SDL_MOUSEMOTION)
+			{
+				if(pendingMotion)
+				{
+					event.motion.xrel += pendingMotion->motion.xrel;
+					event.motion.yrel += pendingMotion->motion.yrel;
+				}
+				pendingMotion = event;
+				continue;
+			}
+
+			//Anything else may depend on where the mouse was, keep ordering intact
+			if(pendingMotion)
+			{
+				dispatch(*pendingMotion);
+				pendingMotion.reset();
+			}
+
+			if(event.type == SDL2pp::EventType::SDL_QUIT)
+			{
+				engine.running = false;
+				continue;
+			}
+			dispatch(event);
+		}
+
+		if(pendingMotion)
+			dispatch(*pendingMotion);
+	}
+
+	//Loads a queued scene or swaps in a streamed one, otherwise advances input, GUI hover state and the heart by one frame
+	export void Tick(Engine& engine)
+	{
+		if(engine.queuedScene)
+		{
+			engine.sceneManager.LoadScene(engine.queuedScene);
+			engine.queuedScene = nullptr;
+
+			//After the load, so whatever the new scene asked for again stays cached
+			engine.assets.ReleaseUnused(AssetResidency::Scene);
+			return;
+		}
+
+		if(engine.sceneManager.IsStreamedSceneReady())
+		{
+			engine.sceneManager.SwapStreamedScene();
+			engine.assets.ReleaseUnused(AssetResidency::Scene);
+			return;
+		}
+
+		engine.assets.Update(engine.renderer);
+		engine.controllerContext.Execute(engine.controller);
+		engine.guiEngine.UpdateHoveredElement();
+		engine.guiEngine.DispatchHoveredEvent();
+		gHeart.Pulse(&engine.jobSystem);
+		engine.controller.SwapBuffers();
+	}
+
+	export void DrawGUI(Renderer& renderer, GUI::GUIEngine& frame)
+	{
+		XK_PROFILE_ZONE("DrawGUI");
+		frame.Redraw(renderer);
+		renderer.backend->Copy(frame.internalTexture.get(), std::nullopt, std::optional<SDL2pp::Rect>(std::nullopt));
+		renderer.stats.drawCalls++;
+	}
+
+	export void Render(Engine& engine)
+	{
+		engine.renderer.backend->SetDrawColor(engine.renderer.clearColor);
+		engine.renderer.backend->Clear();
+		engine.renderer.DrawSprites();
+
+		DrawGUI(engine.renderer, engine.guiEngine);
+
+		for(DebugRenderer debugRenderer{ engine.renderer.GetDebugRenderer() }; auto& callback : engine.renderer.debugCallbacks)
+		{ 
+			callback(debugRenderer); 
+		}
+
+		{
+			XK_PROFILE_ZONE("Present");
+			engine.renderer.backend->Present();
+		}
+		xk::gProfiler.EndFrame();
+	}
+
 	//void Box2DCallbacks::DrawPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color)
 	//{
 	//	engine->renderer.GetDebugRenderer().SetDrawColor({ { color.r, color.g, color.b, color.a } });
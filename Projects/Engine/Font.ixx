@@ -0,0 +1,308 @@
+module;
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+export module DeluEngine:Font;
+import :Renderer;
+import SDL2pp;
+import xk.Math.Matrix;
+
+namespace DeluEngine
+{
+	//One glyph of laid out text, destination is relative to the top left of the text and source is in atlas pixels
+	export struct GlyphQuad
+	{
+		SDL2pp::FRect destination;
+		SDL2pp::Rect source;
+	};
+
+	export struct TextLayout
+	{
+		std::vector<GlyphQuad> quads;
+		xk::Math::Aliases::Vector2 size;
+	};
+
+	//A TTF font with a glyph atlas that is filled on demand
+	//Each glyph is rasterized once, laying out text made of glyphs seen before only computes positions
+	export class Font
+	{
+	private:
+		struct Glyph
+		{
+			SDL2pp::Rect source;
+			int offsetX;
+			int advance;
+		};
+
+		//Spans the whole atlas width, so growing the atlas makes room on every shelf
+		struct Shelf
+		{
+			int y;
+			int height;
+			int cursorX;
+		};
+
+		struct FontDeleter
+		{
+			void operator()(TTF_Font* font) const noexcept { TTF_CloseFont(font); }
+		};
+
+		static constexpr int initialAtlasSize = 256;
+		static constexpr int maxAtlasSize = 4096;
+		static constexpr int glyphPadding = 1;
+
+		std::unique_ptr<TTF_Font, FontDeleter> m_font;
+		std::unordered_map<char32_t, Glyph> m_glyphs;
+		int m_lineSkip;
+
+		//CPU copy of the atlas so it can be grown and re-uploaded without reading back from the GPU
+		SDL2pp::unique_ptr<SDL2pp::Surface> m_atlasSurface;
+		SDL2pp::unique_ptr<SDL2pp::Texture> m_atlasTexture;
+		std::vector<Shelf> m_shelves;
+		bool m_atlasDirty = false;
+
+	public:
+		Font(const std::string& path, int pointSize) :
+			m_font{ TTF_OpenFont(path.c_str(), pointSize) }
+		{
+			if(!m_font)
+				throw std::runtime_error("Failed to open font " + path + ": " + TTF_GetError());
+
+			m_lineSkip = TTF_FontLineSkip(m_font.get());
+			m_atlasSurface = SDL2pp::CreateSurface({ initialAtlasSize, initialAtlasSize }, SDL_PIXELFORMAT_RGBA32);
+		}
+
+		TTF_Font* Get() const noexcept { return m_font.get(); }
+		int GetLineSkip() const noexcept { return m_lineSkip; }
+
+		//Lays text out from the top left, wrapping words that would cross wrapWidth, 0 disables wrapping
+		//layout's storage is reused so relaying out text of a similar length doesn't allocate
+		void Layout(std::string_view text, float wrapWidth, TextLayout& layout)
+		{
+			layout.quads.clear();
+			layout.size = {};
+
+			float penX = 0;
+			float penY = 0;
+
+			//Start of the word being laid out so it can be moved to the next line as a whole
+			std::size_t wordStart = 0;
+			float wordStartX = 0;
+			char32_t previous = 0;
+
+			for(std::size_t i = 0; i < text.size();)
+			{
+				const char32_t codepoint = DecodeUTF8(text, i);
+				if(codepoint == U'\n')
+				{
+					penX = 0;
+					penY += m_lineSkip;
+					wordStart = layout.quads.size();
+					wordStartX = 0;
+					previous = 0;
+					continue;
+				}
+
+				const Glyph& glyph = GetGlyph(codepoint);
+				if(previous != 0)
+					penX += TTF_GetFontKerningSizeGlyphs32(m_font.get(), previous, codepoint);
+				previous = codepoint;
+
+				if(codepoint == U' ')
+				{
+					penX += glyph.advance;
+					wordStart = layout.quads.size();
+					wordStartX = penX;
+					continue;
+				}
+
+				if(wrapWidth > 0 && penX > 0 && penX + glyph.advance > wrapWidth)
+				{
+					if(wordStartX > 0)
+					{
+						for(std::size_t j = wordStart; j < layout.quads.size(); j++)
+						{
+							layout.quads[j].destination.x -= wordStartX;
+							layout.quads[j].destination.y += m_lineSkip;
+						}
+						penX -= wordStartX;
+					}
+					else
+					{
+						//The word alone is wider than the line, break it where it is
+						penX = 0;
+						wordStart = layout.quads.size();
+					}
+					penY += m_lineSkip;
+					wordStartX = 0;
+				}
+
+				if(glyph.source.w > 0)
+				{
+					layout.quads.push_back(
+						{
+							.destination{ penX + glyph.offsetX, penY, static_cast<float>(glyph.source.w), static_cast<float>(glyph.source.h) },
+							.source = glyph.source
+						});
+				}
+				penX += glyph.advance;
+			}
+
+			for(const GlyphQuad& quad : layout.quads)
+			{
+				layout.size.X() = std::max(layout.size.X(), quad.destination.x + quad.destination.w);
+				layout.size.Y() = std::max(layout.size.Y(), quad.destination.y + quad.destination.h);
+			}
+		}
+
+		//Uploads glyphs rasterized since the last call
+		SDL2pp::Texture* GetAtlas(Renderer& renderer)
+		{
+			if(!m_atlasTexture)
+			{
+				m_atlasTexture = renderer.backend->CreateTexture(SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, m_atlasSurface.get()->w, m_atlasSurface.get()->h);
+				m_atlasTexture->SetBlendMode(SDL_BLENDMODE_BLEND);
+				m_atlasDirty = true;
+			}
+
+			if(m_atlasDirty)
+			{
+				m_atlasTexture->Update(std::nullopt, m_atlasSurface.get()->pixels, m_atlasSurface.get()->pitch);
+				m_atlasDirty = false;
+			}
+			return m_atlasTexture.get();
+		}
+
+		xk::Math::Aliases::Vector2 GetAtlasSize() const noexcept
+		{
+			return { static_cast<float>(m_atlasSurface.get()->w), static_cast<float>(m_atlasSurface.get()->h) };
+		}
+
+	private:
+		static char32_t DecodeUTF8(std::string_view text, std::size_t& i)
+		{
+			const auto lead = static_cast<unsigned char>(text[i++]);
+			const int continuationBytes = lead < 0x80 ? 0 : lead < 0xE0 ? 1 : lead < 0xF0 ? 2 : 3;
+			char32_t codepoint = continuationBytes == 0 ? lead : lead & (0x3F >> continuationBytes);
+			for(int j = 0; j < continuationBytes; j++)
+			{
+				if(i >= text.size() || (static_cast<unsigned char>(text[i]) & 0xC0) != 0x80)
+					return U'\uFFFD';
+				codepoint = (codepoint << 6) | (static_cast<unsigned char>(text[i++]) & 0x3F);
+			}
+			return codepoint;
+		}
+
+		const Glyph& GetGlyph(char32_t codepoint)
+		{
+			if(auto it = m_glyphs.find(codepoint); it != m_glyphs.end())
+				return it->second;
+
+			Glyph glyph{};
+			int minX = 0;
+			TTF_GlyphMetrics32(m_font.get(), codepoint, &minX, nullptr, nullptr, nullptr, &glyph.advance);
+
+			//The rendered surface starts at the pen position unless the glyph extends left of it
+			glyph.offsetX = std::min(minX, 0);
+
+			SDL2pp::unique_ptr<SDL2pp::Surface> surface = codepoint == U' ' ? nullptr : TTF_RenderGlyph32_Blended(m_font.get(), codepoint, { 255, 255, 255, 255 });
+			if(surface)
+			{
+				glyph.source = Pack({ surface.get()->w, surface.get()->h });
+				SDL_SetSurfaceBlendMode(surface.get(), SDL_BLENDMODE_NONE);
+				SDL_BlitSurface(surface.get(), nullptr, m_atlasSurface.get(), &glyph.source);
+				m_atlasDirty = true;
+			}
+
+			return m_glyphs.emplace(codepoint, glyph).first->second;
+		}
+
+		//Shelf packing, a glyph goes on the first shelf with room for it and a new shelf is started below the others otherwise
+		SDL2pp::Rect Pack(xk::Math::Aliases::iVector2 size)
+		{
+			while(true)
+			{
+				const int width = m_atlasSurface.get()->w;
+				const int height = m_atlasSurface.get()->h;
+				if(size.X() <= width)
+				{
+					for(std::size_t i = 0; i < m_shelves.size(); i++)
+					{
+						Shelf& shelf = m_shelves[i];
+
+						//Only the bottom shelf may grow taller, any other would run into the shelf below it
+						const int shelfHeight = i + 1 == m_shelves.size() ? std::max(shelf.height, size.Y()) : shelf.height;
+						if(shelf.cursorX + size.X() <= width && size.Y() <= shelfHeight && shelf.y + shelfHeight <= height)
+						{
+							const SDL2pp::Rect rect{ shelf.cursorX, shelf.y, size.X(), size.Y() };
+							shelf.cursorX += size.X() + glyphPadding;
+							shelf.height = shelfHeight;
+							return rect;
+						}
+					}
+
+					const int shelfY = m_shelves.empty() ? 0 : m_shelves.back().y + m_shelves.back().height + glyphPadding;
+					if(shelfY + size.Y() <= height)
+					{
+						m_shelves.push_back({ shelfY, size.Y(), size.X() + glyphPadding });
+						return { 0, shelfY, size.X(), size.Y() };
+					}
+				}
+
+				GrowAtlas();
+			}
+		}
+
+		//Existing glyphs keep their pixel coordinates, only the texture is recreated
+		//Shelves carry on into the new right half and new shelves go below them
+		void GrowAtlas()
+		{
+			const int size = m_atlasSurface.get()->w * 2;
+			if(size > maxAtlasSize)
+				throw std::runtime_error("Glyph atlas is full");
+
+			auto surface = SDL2pp::CreateSurface({ size, size }, SDL_PIXELFORMAT_RGBA32);
+			SDL_SetSurfaceBlendMode(m_atlasSurface.get(), SDL_BLENDMODE_NONE);
+			SDL_BlitSurface(m_atlasSurface.get(), nullptr, surface.get(), nullptr);
+			m_atlasSurface = std::move(surface);
+			m_atlasTexture = nullptr;
+		}
+	};
+
+	//Opens each font file once per point size, fonts stay open for the life of the cache
+	export class FontCache
+	{
+	private:
+		std::map<std::pair<std::string, int>, std::unique_ptr<Font>> m_fonts;
+
+	public:
+		Font& Get(std::string path, int pointSize)
+		{
+			auto [it, inserted] = m_fonts.try_emplace({ std::move(path), pointSize });
+			if(inserted)
+			{
+				try
+				{
+					it->second = std::make_unique<Font>(it->first.first, pointSize);
+				}
+				catch(...)
+				{
+					m_fonts.erase(it);
+					throw;
+				}
+			}
+			return *it->second;
+		}
+	};
+}
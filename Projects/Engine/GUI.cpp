@@ -1,13 +1,20 @@
 module;
 
+#include <algorithm>
+#include <functional>
+#include <numeric>
 #include <vector>
 #include <variant>
 #include <concepts>
 #include <iostream>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <utility>
 
-module DeluEngine:GUI;
+module DeluEngine;
 //import :Renderer;
 import SDL2pp;
 
@@ -30,49 +37,9 @@ namespace DeluEngine::GUI
 	{
 		auto reparent = [this, newParent]()
 		{
-			auto updateRootElements = [this, oldParent = m_parent, newParent]()
-			{
-				try
-				{
-					if(!newParent)
-					{
-						m_engine->rootElements.push_back(this);
-					}
-					else if(!oldParent && newParent)
-					{
-						std::erase(m_engine->rootElements, this);
-					}
-				}
-				catch(...)
-				{
-					if(!newParent)
-					{
-						std::erase(m_engine->rootElements, this);
-					}
-					else if(!oldParent && newParent)
-					{
-						m_engine->rootElements.push_back(this);
-					}
-				}
-			};
-			if(m_parent)
-			{
-				std::erase(m_parent->m_children, this);
-			}
-
-			try
-			{
-				if(newParent)
-				{
-					newParent->m_children.push_back(this);
-				}
-				updateRootElements();
-				m_parent = newParent;
-			}
-			catch(...)
-			{
-				m_parent->m_children.push_back(this);
-			}
+			Unlink();
+			m_parent = newParent;
+			Link();
 		};
 
 		switch(logic)
@@ -125,8 +92,11 @@ namespace DeluEngine::GUI
 				using underlying_type = std::remove_cvref_t<decltype(underlyingEvent)>;
 				if constexpr(std::same_as<underlying_type, DrawEvent>)
 				{
-					if(render)
-						underlyingEvent.renderer->backend->CopyEx(texture.get(), std::nullopt, GetSDLRect(*this), 0, SDL2pp::FPoint{ 0, 0 }, SDL2pp::RendererFlip::SDL_FLIP_NONE);
+					if(IsRendered() && m_texture)
+					{
+						underlyingEvent.drawList->BeginItem(m_texture.get(), GetRect());
+						underlyingEvent.drawList->AddQuad(GetSDLRect(*this), SDL2pp::FRect{ 0, 0, 1, 1 });
+					}
 
 					return defaultSuccessCode;
 				}
@@ -145,8 +115,11 @@ namespace DeluEngine::GUI
 				using underlying_type = std::remove_cvref_t<decltype(underlyingEvent)>;
 				if constexpr(std::same_as<underlying_type, DrawEvent>)
 				{
-					if(render)
-						underlyingEvent.renderer->backend->CopyEx(texture.get(), std::nullopt, GetSDLRect(*this), 0, SDL2pp::FPoint{ 0, 0 }, SDL2pp::RendererFlip::SDL_FLIP_NONE);
+					if(IsRendered() && m_texture)
+					{
+						underlyingEvent.drawList->BeginItem(m_texture.get(), GetRect());
+						underlyingEvent.drawList->AddQuad(GetSDLRect(*this), SDL2pp::FRect{ 0, 0, 1, 1 });
+					}
 
 					return defaultSuccessCode;
 				}
@@ -205,8 +178,22 @@ namespace DeluEngine::GUI
 
 	void Text::SetText(std::string_view text)
 	{
+		if(m_text == text)
+			return;
+
 		m_text = text;
 		m_dirty = true;
+		GetGUIEngine().QueuePrepareDraw(*this);
+	}
+
+	void Text::SetFont(Font* font)
+	{
+		if(m_font == font)
+			return;
+
+		m_font = font;
+		m_dirty = true;
+		GetGUIEngine().QueuePrepareDraw(*this);
 	}
 
 	int DeluEngine::GUI::Text::HandleEvent(const Event& event)
@@ -214,23 +201,37 @@ namespace DeluEngine::GUI
 		return std::visit([&, this](const auto& underlyingEvent) -> int
 			{
 				using underlying_type = std::remove_cvref_t<decltype(underlyingEvent)>;
-				if constexpr(std::same_as<underlying_type, DrawEvent>)
+				if constexpr(std::same_as<underlying_type, PrepareDrawEvent>)
 				{
-					if(m_dirty)
-					{
-						SDL_Surface* tempSurface = TTF_RenderUTF8_Solid_Wrapped(m_font, m_text.data(), { 255, 255, 255 }, GetFrameSizeAs<AbsoluteSize>().value.X());
-						m_texture = SDL_CreateTextureFromSurface(underlyingEvent.renderer->backend.get(), tempSurface);
-						m_textBounds.value = { tempSurface->w, tempSurface->h };
-						SDL_FreeSurface(tempSurface);
-						m_dirty = false;
-					}
+					if(!m_dirty)
+						return defaultSuccessCode;
+
+					if(m_font)
+						m_font->Layout(m_text, GetFrameSizeAs<AbsoluteSize>().value.X(), m_layout);
+					else
+						m_layout = {};
+					m_textBounds.value = m_layout.size;
+					m_dirty = false;
 
-					if(render)
+					//Covers both the previously drawn bounds and the new ones
+					MarkDirty();
+					return defaultSuccessCode;
+				}
+				else if constexpr(std::same_as<underlying_type, DrawEvent>)
+				{
+					if(IsRendered() && m_font && !m_layout.quads.empty())
 					{
-						auto rect = GetSDLRect(*this);
-						rect.w = m_textBounds.value.X();
-						rect.h = m_textBounds.value.Y();
-						underlyingEvent.renderer->backend->CopyEx(m_texture.get(), std::nullopt, rect, 0, SDL2pp::FPoint{ 0, 0 }, SDL2pp::RendererFlip::SDL_FLIP_NONE);
+						SDL2pp::Texture* atlas = m_font->GetAtlas(*underlyingEvent.renderer);
+						const xk::Math::Aliases::Vector2 atlasSize = m_font->GetAtlasSize();
+						const auto origin = GetSDLRect(*this);
+
+						underlyingEvent.drawList->BeginItem(atlas, GetDrawRect());
+						for(const GlyphQuad& quad : m_layout.quads)
+						{
+							underlyingEvent.drawList->AddQuad(
+								SDL2pp::FRect{ origin.x + quad.destination.x, origin.y + quad.destination.y, quad.destination.w, quad.destination.h },
+								SDL2pp::FRect{ quad.source.x / atlasSize.X(), quad.source.y / atlasSize.Y(), quad.source.w / atlasSize.X(), quad.source.h / atlasSize.Y() });
+						}
 					}
 
 					return defaultSuccessCode;
@@ -240,6 +241,249 @@ namespace DeluEngine::GUI
 			}, event);
 	}
 
+	void HitTestGrid::Rebuild(UIElement* lastRootElement, AbsoluteSize frameSize)
+	{
+		m_order.clear();
+		auto flatten = [this](auto& self, UIElement& element) -> void
+			{
+				for(UIElement* child : element.GetChildren())
+				{
+					self(self, *child);
+				}
+				m_order.push_back(&element);
+			};
+		for(UIElement* root = lastRootElement; root; root = root->GetPreviousSibling())
+		{
+			flatten(flatten, *root);
+		}
+
+		m_cellCount = { std::max(1, static_cast<int>(std::ceil(frameSize.value.X() / cellSize))), std::max(1, static_cast<int>(std::ceil(frameSize.value.Y() / cellSize))) };
+		m_cells.resize(static_cast<std::size_t>(m_cellCount.X()) * m_cellCount.Y());
+		for(Cell& cell : m_cells)
+		{
+			cell.left.clear();
+			cell.bottom.clear();
+			cell.right.clear();
+			cell.top.clear();
+			cell.elements.clear();
+		}
+
+		//Elements reaching outside the frame land in the edge cells, which clamped lookups also use
+		for(UIElement* element : m_order)
+		{
+			const Rect rect = element->GetRect();
+			const xk::Math::Aliases::iVector2 first = GetCell(rect.bottomLeft.value);
+			const xk::Math::Aliases::iVector2 last = GetCell(rect.topRight.value);
+			for(int y = first.Y(); y <= last.Y(); y++)
+			{
+				for(int x = first.X(); x <= last.X(); x++)
+				{
+					Cell& cell = m_cells[static_cast<std::size_t>(y) * m_cellCount.X() + x];
+					cell.left.push_back(rect.bottomLeft.value.X());
+					cell.bottom.push_back(rect.bottomLeft.value.Y());
+					cell.right.push_back(rect.topRight.value.X());
+					cell.top.push_back(rect.topRight.value.Y());
+					cell.elements.push_back(element);
+				}
+			}
+		}
+	}
+
+	UIElement* HitTestGrid::Find(AbsolutePosition position) const noexcept
+	{
+		if(m_cells.empty())
+			return nullptr;
+
+		const xk::Math::Aliases::iVector2 cellPosition = GetCell(position.value);
+		const Cell& cell = m_cells[static_cast<std::size_t>(cellPosition.Y()) * m_cellCount.X() + cellPosition.X()];
+		const float x = position.value.X();
+		const float y = position.value.Y();
+		for(std::size_t i = 0; i < cell.elements.size(); i++)
+		{
+			if(cell.left[i] <= x && x <= cell.right[i] && cell.bottom[i] <= y && y <= cell.top[i] && cell.elements[i]->debugEnableRaytrace)
+				return cell.elements[i];
+		}
+		return nullptr;
+	}
+
+	xk::Math::Aliases::iVector2 HitTestGrid::GetCell(xk::Math::Aliases::Vector2 position) const noexcept
+	{
+		return
+		{
+			std::clamp(static_cast<int>(std::floor(position.X() / cellSize)), 0, m_cellCount.X() - 1),
+			std::clamp(static_cast<int>(std::floor(position.Y() / cellSize)), 0, m_cellCount.Y() - 1)
+		};
+	}
+
+	void GUIEngine::Redraw(DeluEngine::Renderer& renderer)
+	{
+		for(std::size_t i = 0; i < pendingPrepareElements.size(); i++)
+		{
+			pendingPrepareElements[i]->m_prepareQueued = false;
+			pendingPrepareElements[i]->HandleEvent(PrepareDrawEvent{ &renderer });
+		}
+		pendingPrepareElements.clear();
+
+		if(internalTexture.get() != retainedTexture)
+		{
+			retainedTexture = internalTexture.get();
+			MarkAllDirty();
+		}
+
+		if(!dirtyRegion)
+			return;
+
+		const Rect region = *std::exchange(dirtyRegion, std::nullopt);
+		const float frameHeight = GetFrameSize().value.Y();
+
+		//Padded by a pixel to cover filtering at the region's edges
+		const int left = static_cast<int>(std::floor(region.bottomLeft.value.X())) - 1;
+		const int top = static_cast<int>(std::floor(frameHeight - region.topRight.value.Y())) - 1;
+		const int right = static_cast<int>(std::ceil(region.topRight.value.X())) + 1;
+		const int bottom = static_cast<int>(std::ceil(frameHeight - region.bottomLeft.value.Y())) + 1;
+
+		renderer.backend->SetRenderTarget(internalTexture.get());
+		renderer.backend->SetClipRect(SDL2pp::Rect{ left, top, right - left, bottom - top });
+
+		//Clearing has to overwrite the region's alpha instead of blending with it
+		const SDL_BlendMode previousBlendMode = renderer.backend->GetDrawBlendMode();
+		renderer.backend->SetDrawBlendMode(SDL_BLENDMODE_NONE);
+		renderer.backend->SetDrawColor(SDL2pp::Color{ { 0, 0, 0, 0 } });
+		renderer.backend->FillRect();
+		renderer.backend->SetDrawBlendMode(previousBlendMode);
+
+		m_drawList.Reset();
+		for(UIElement* element : GetRootElements())
+		{
+			CompileDrawList(renderer, *element, region);
+		}
+		SubmitDrawList(renderer);
+
+		renderer.backend->SetClipRect(std::nullopt);
+		renderer.backend->SetRenderTarget(nullptr);
+	}
+
+	void GUIEngine::CompileDrawList(DeluEngine::Renderer& renderer, UIElement& element, const Rect& region)
+	{
+		if(element.IsRendered())
+		{
+			const Rect drawRect = element.GetDrawRect();
+			if(drawRect.Intersects(region))
+				element.HandleEvent(DrawEvent{ &renderer, &m_drawList });
+			element.m_drawnRect = drawRect;
+		}
+		else
+		{
+			element.m_drawnRect = std::nullopt;
+		}
+
+		for(UIElement* child : element.GetChildren())
+		{
+			CompileDrawList(renderer, *child, region);
+		}
+	}
+
+	void GUIEngine::SubmitDrawList(DeluEngine::Renderer& renderer)
+	{
+		const std::vector<GUIDrawList::Item>& items = m_drawList.items;
+
+		//Layers only depend on each item's texture and bounds, which stay the same until the layout changes
+		//so redrawing text or an animation in place keeps the previous order
+		const bool sameItems = std::ranges::equal(items, m_layeredItems, [](const GUIDrawList::Item& lh, const GUIDrawList::Item& rh)
+			{
+				return lh.texture == rh.texture
+					&& lh.bounds.bottomLeft.value.X() == rh.bounds.bottomLeft.value.X() && lh.bounds.bottomLeft.value.Y() == rh.bounds.bottomLeft.value.Y()
+					&& lh.bounds.topRight.value.X() == rh.bounds.topRight.value.X() && lh.bounds.topRight.value.Y() == rh.bounds.topRight.value.Y();
+			});
+		if(!sameItems)
+		{
+			AssignDrawLayers();
+			m_layeredItems = items;
+		}
+
+		for(std::size_t batchStart = 0; batchStart < m_drawOrder.size();)
+		{
+			const GUIDrawList::Item& first = items[m_drawOrder[batchStart]];
+			const int layer = m_drawLayers[m_drawOrder[batchStart]];
+
+			m_batchVertices.clear();
+			m_batchIndices.clear();
+			std::size_t batchEnd = batchStart;
+			for(; batchEnd < m_drawOrder.size(); batchEnd++)
+			{
+				const GUIDrawList::Item& item = items[m_drawOrder[batchEnd]];
+				if(item.texture != first.texture || m_drawLayers[m_drawOrder[batchEnd]] != layer)
+					break;
+
+				const int baseVertex = static_cast<int>(m_batchVertices.size());
+				m_batchVertices.insert(m_batchVertices.end(), m_drawList.vertices.begin() + item.firstVertex, m_drawList.vertices.begin() + item.firstVertex + item.vertexCount);
+				for(std::size_t i = item.firstIndex; i < item.firstIndex + item.indexCount; i++)
+				{
+					m_batchIndices.push_back(baseVertex + m_drawList.indices[i]);
+				}
+			}
+
+			renderer.backend->DrawGeometry(first.texture, m_batchVertices, m_batchIndices);
+			renderer.stats.drawCalls++;
+			batchStart = batchEnd;
+		}
+	}
+
+	//Each item is put on a layer above every earlier item it overlaps that uses a different texture
+	//Sorting by layer then texture keeps the painter's order where it is visible and merges everything else
+	void GUIEngine::AssignDrawLayers()
+	{
+		const std::vector<GUIDrawList::Item>& items = m_drawList.items;
+
+		//Earlier items are bucketed over the frame like the hit test grid, so only items sharing a cell are compared
+		//Items reaching outside the frame land in the edge cells, overlapping items always share at least one cell
+		const xk::Math::Aliases::Vector2 frameSize = GetFrameSize().value;
+		const xk::Math::Aliases::iVector2 cellCount{ std::max(1, static_cast<int>(std::ceil(frameSize.X() / HitTestGrid::cellSize))), std::max(1, static_cast<int>(std::ceil(frameSize.Y() / HitTestGrid::cellSize))) };
+		auto getCell = [cellCount](xk::Math::Aliases::Vector2 position) -> xk::Math::Aliases::iVector2
+			{
+				return
+				{
+					std::clamp(static_cast<int>(std::floor(position.X() / HitTestGrid::cellSize)), 0, cellCount.X() - 1),
+					std::clamp(static_cast<int>(std::floor(position.Y() / HitTestGrid::cellSize)), 0, cellCount.Y() - 1)
+				};
+			};
+
+		m_drawCells.resize(static_cast<std::size_t>(cellCount.X()) * cellCount.Y());
+		for(std::vector<std::uint32_t>& cell : m_drawCells)
+		{
+			cell.clear();
+		}
+
+		m_drawLayers.assign(items.size(), 0);
+		for(std::uint32_t i = 0; i < items.size(); i++)
+		{
+			const xk::Math::Aliases::iVector2 first = getCell(items[i].bounds.bottomLeft.value);
+			const xk::Math::Aliases::iVector2 last = getCell(items[i].bounds.topRight.value);
+			for(int y = first.Y(); y <= last.Y(); y++)
+			{
+				for(int x = first.X(); x <= last.X(); x++)
+				{
+					std::vector<std::uint32_t>& cell = m_drawCells[static_cast<std::size_t>(y) * cellCount.X() + x];
+					for(std::uint32_t j : cell)
+					{
+						if(items[i].bounds.Intersects(items[j].bounds))
+							m_drawLayers[i] = std::max(m_drawLayers[i], m_drawLayers[j] + (items[i].texture != items[j].texture ? 1 : 0));
+					}
+					cell.push_back(i);
+				}
+			}
+		}
+
+		m_drawOrder.resize(items.size());
+		std::iota(m_drawOrder.begin(), m_drawOrder.end(), std::size_t{ 0 });
+		std::stable_sort(m_drawOrder.begin(), m_drawOrder.end(), [&](std::size_t lh, std::size_t rh)
+			{
+				if(m_drawLayers[lh] != m_drawLayers[rh])
+					return m_drawLayers[lh] < m_drawLayers[rh];
+				return std::less<>{}(items[lh].texture, items[rh].texture);
+			});
+	}
+
 	void ProcessEvent(GUIEngine& engine, const SDL2pp::Event& event,  xk::Math::Aliases::Vector2 windowSize)
 	{
 		switch(event.type)
@@ -7,15 +7,19 @@ module;
 #include <vector>
 #include <optional>
 #include <memory>
+#include <new>
 #include <string>
 #include <SDL2/SDL_ttf.h>
 #include <string_view>
+#include <cstddef>
+#include <cstdint>
 
 export module DeluEngine:GUI;
 import xk.Math.Matrix;
 import xk.Math.Algorithms;
 import SDL2pp;
 import :Renderer;
+import :Font;
 
 
 //namespace DeluEngine
@@ -287,6 +291,21 @@ namespace DeluEngine::GUI
 		{
 			return Overlaps(other.bottomLeft) || Overlaps(other.topRight);
 		}
+
+		bool Intersects(const Rect& other) const noexcept
+		{
+			return bottomLeft.value.X() <= other.topRight.value.X() && other.bottomLeft.value.X() <= topRight.value.X()
+				&& bottomLeft.value.Y() <= other.topRight.value.Y() && other.bottomLeft.value.Y() <= topRight.value.Y();
+		}
+
+		Rect Union(const Rect& other) const noexcept
+		{
+			return
+			{
+				AbsolutePosition{ { std::min(bottomLeft.value.X(), other.bottomLeft.value.X()), std::min(bottomLeft.value.Y(), other.bottomLeft.value.Y()) } },
+				AbsolutePosition{ { std::max(topRight.value.X(), other.topRight.value.X()), std::max(topRight.value.Y(), other.topRight.value.Y()) } }
+			};
+		}
 	};
 
 	constexpr int defaultSuccessCode = 0;
@@ -316,12 +335,69 @@ namespace DeluEngine::GUI
 		static constexpr int unhandledCode = 1;
 	};
 
+	//Geometry emitted by elements during a redraw, batched by texture before it is submitted
+	export struct GUIDrawList
+	{
+		struct Item
+		{
+			SDL2pp::Texture* texture;
+			Rect bounds;
+			std::size_t firstVertex;
+			std::size_t vertexCount;
+			std::size_t firstIndex;
+			std::size_t indexCount;
+		};
+
+		std::vector<Item> items;
+		std::vector<SDL2pp::Vertex> vertices;
+
+		//Relative to the first vertex of their item
+		std::vector<int> indices;
+
+		//Geometry added until the next call belongs to this item
+		//bounds decide which items may be reordered past each other when batching
+		void BeginItem(SDL2pp::Texture* texture, const Rect& bounds)
+		{
+			items.push_back({ texture, bounds, vertices.size(), 0, indices.size(), 0 });
+		}
+
+		//destination is in SDL coordinates, source in normalized texture coordinates
+		void AddQuad(const SDL2pp::FRect& destination, const SDL2pp::FRect& source)
+		{
+			Item& item = items.back();
+			const int first = static_cast<int>(item.vertexCount);
+			constexpr SDL_Color white{ 255, 255, 255, 255 };
+			vertices.push_back({ { destination.x, destination.y }, white, { source.x, source.y } });
+			vertices.push_back({ { destination.x + destination.w, destination.y }, white, { source.x + source.w, source.y } });
+			vertices.push_back({ { destination.x + destination.w, destination.y + destination.h }, white, { source.x + source.w, source.y + source.h } });
+			vertices.push_back({ { destination.x, destination.y + destination.h }, white, { source.x, source.y + source.h } });
+			indices.insert(indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+			item.vertexCount += 4;
+			item.indexCount += 6;
+		}
+
+		void Reset()
+		{
+			items.clear();
+			vertices.clear();
+			indices.clear();
+		}
+	};
+
 	export struct DrawEvent
 	{
 		DeluEngine::Renderer* renderer;
+		GUIDrawList* drawList;
 	};
 
-	export using Event = std::variant<MouseEvent, DrawEvent>;
+	//Sent before a redraw to elements that queued themselves with GUIEngine::QueuePrepareDraw
+	//so they can rebuild render resources and report their new bounds before dirty regions are resolved
+	export struct PrepareDrawEvent
+	{
+		DeluEngine::Renderer* renderer;
+	};
+
+	export using Event = std::variant<MouseEvent, DrawEvent, PrepareDrawEvent>;
 
 	export class UIElement;
 
@@ -343,6 +419,90 @@ namespace DeluEngine::GUI
 	export struct GUIEngine;
 	struct UIElementDeleter;
 
+	//Walks a sibling list through the elements' intrusive links
+	export class ElementIterator
+	{
+	private:
+		UIElement* m_element = nullptr;
+
+	public:
+		using value_type = UIElement*;
+		using difference_type = std::ptrdiff_t;
+
+		ElementIterator() noexcept = default;
+		explicit ElementIterator(UIElement* element) noexcept : m_element{ element } {}
+
+		UIElement* operator*() const noexcept { return m_element; }
+		ElementIterator& operator++() noexcept;
+		ElementIterator operator++(int) noexcept { ElementIterator copy = *this; ++*this; return copy; }
+		friend bool operator==(const ElementIterator&, const ElementIterator&) noexcept = default;
+	};
+
+	export struct ElementRange
+	{
+		UIElement* first = nullptr;
+
+		ElementIterator begin() const noexcept { return ElementIterator{ first }; }
+		ElementIterator end() const noexcept { return ElementIterator{}; }
+		bool empty() const noexcept { return first == nullptr; }
+	};
+
+	//Fixed size slots carved out of chunks, a destroyed element's slot is reused by the next one of the same size class
+	//Keeps elements of a scene close together and avoids a heap allocation per element
+	class ElementPool
+	{
+	private:
+		static constexpr std::size_t slotAlignment = alignof(std::max_align_t);
+		static constexpr std::size_t slotsPerChunk = 64;
+
+		struct SizeClass
+		{
+			std::vector<std::unique_ptr<std::byte[]>> chunks;
+			std::vector<void*> freeSlots;
+		};
+
+		std::vector<SizeClass> m_sizeClasses;
+
+	public:
+		template<class Ty>
+		static constexpr bool CanHold = alignof(Ty) <= slotAlignment;
+
+		void* Allocate(std::size_t size)
+		{
+			const std::size_t index = GetSizeClass(size);
+			if(index >= m_sizeClasses.size())
+				m_sizeClasses.resize(index + 1);
+
+			SizeClass& sizeClass = m_sizeClasses[index];
+			if(sizeClass.freeSlots.empty())
+			{
+				const std::size_t slotSize = (index + 1) * slotAlignment;
+				std::byte* chunk = sizeClass.chunks.emplace_back(new std::byte[slotSize * slotsPerChunk]).get();
+				sizeClass.freeSlots.reserve(sizeClass.chunks.size() * slotsPerChunk);
+				for(std::size_t i = slotsPerChunk; i > 0; i--)
+				{
+					sizeClass.freeSlots.push_back(chunk + (i - 1) * slotSize);
+				}
+			}
+
+			void* slot = sizeClass.freeSlots.back();
+			sizeClass.freeSlots.pop_back();
+			return slot;
+		}
+
+		//Never allocates, the free list was reserved for every slot when its chunk was created
+		void Deallocate(void* slot, std::size_t size) noexcept
+		{
+			m_sizeClasses[GetSizeClass(size)].freeSlots.push_back(slot);
+		}
+
+	private:
+		static std::size_t GetSizeClass(std::size_t size) noexcept
+		{
+			return (size + slotAlignment - 1) / slotAlignment - 1;
+		}
+	};
+
 	export class UIElement
 	{
 		friend GUIEngine;
@@ -351,13 +511,34 @@ namespace DeluEngine::GUI
 	private:
 		GUIEngine* m_engine = nullptr;
 		UIElement* m_parent = nullptr;
-		std::vector<UIElement*> m_children;
+
+		//Intrusive child list so linking and unlinking never searches or allocates
+		UIElement* m_firstChild = nullptr;
+		UIElement* m_lastChild = nullptr;
+		UIElement* m_previousSibling = nullptr;
+		UIElement* m_nextSibling = nullptr;
 		PositionVariant m_position;
 		SizeVariant m_size;
 		xk::Math::Aliases::Vector2 m_pivot;
+		bool m_render = true;
+
+		//Area covered the last time this element was drawn into the GUI texture
+		std::optional<Rect> m_drawnRect;
+
+		//Resolved pivoted frame rect, valid while m_layoutVersion matches the engine's frame version
+		//Cleared top down by MarkLayoutDirty so every query after a change resolves the tree once
+		mutable Rect m_layoutRect;
+		mutable std::uint64_t m_layoutVersion = 0;
+
+		//Pool slot size, set by GUIEngine::NewElement
+		std::size_t m_allocationSize = 0;
+		bool m_prepareQueued = false;
+		bool m_pendingDelete = false;
 
 	public:
 		std::string debugName;
+
+		//Set through SetRaytrace once the element is live so cached hover results are refreshed
 		bool debugEnableRaytrace = false;
 
 	public:
@@ -376,24 +557,44 @@ namespace DeluEngine::GUI
 		}
 
 		UIElement(const UIElement&) = delete;
-		UIElement(UIElement&&) noexcept = default;
+		//Siblings, children and the engine point at elements, so they never move
+		UIElement(UIElement&&) = delete;
 
 		virtual ~UIElement();
 
 		UIElement& operator=(const UIElement&) = delete;
-		UIElement& operator=(UIElement&&) noexcept = default;
+		UIElement& operator=(UIElement&&) = delete;
 
 	public:
 		virtual int HandleEvent(const Event& event);
 
-		const std::vector<UIElement*>& GetChildren() const noexcept { return m_children; }
+		ElementRange GetChildren() const noexcept { return { m_firstChild }; }
+		UIElement* GetNextSibling() const noexcept { return m_nextSibling; }
+		UIElement* GetPreviousSibling() const noexcept { return m_previousSibling; }
+
+		GUIEngine& GetGUIEngine() const noexcept { return *m_engine; }
+
+		bool IsRendered() const noexcept { return m_render; }
 
-		Rect GetRect() const noexcept
+		void SetRaytrace(bool raytrace) noexcept;
+
+		void SetRender(bool render) noexcept
+		{
+			if(m_render == render)
+				return;
+
+			m_render = render;
+			MarkDirty();
+		}
+
+		//Area this element draws to, which can differ from the layout rect
+		virtual Rect GetDrawRect() const noexcept
 		{
-			AbsolutePosition bottomLeft = GetPivotedFramePositionAs<AbsolutePosition>();
-			return { bottomLeft, AbsolutePosition{ bottomLeft.value + GetFrameSizeAs<AbsoluteSize>().value} };
+			return GetRect();
 		}
 
+		Rect GetRect() const noexcept;
+
 		xk::Math::Aliases::Vector2 GetPivot() const noexcept
 		{
 			return m_pivot;
@@ -410,12 +611,7 @@ namespace DeluEngine::GUI
 		template<VariantMember<PositionVariant> Ty>
 		Ty GetPivotedFramePositionAs() const noexcept
 		{
-			return std::visit([this](const auto& val) -> Ty
-				{
-					const xk::Math::Aliases::Vector2 size = GetFrameSizeAs<AbsoluteSize>().value;
-					const xk::Math::Aliases::Vector2 pivotOffset = { GetPivot().X() * -size.X(), GetPivot().Y() * -size.Y() };
-					return ConvertPositionRepresentation<Ty>(AbsolutePosition{ GetLocalPositionAs<AbsolutePosition>().value + GetParentPivotedFrameAbsolutePosition().value + pivotOffset }, GetRendererSize());
-				}, m_position);
+			return ConvertPositionRepresentation<Ty>(GetRect().bottomLeft, GetRendererSize());
 		}
 
 		template<VariantMember<PositionVariant> Ty>
@@ -430,7 +626,8 @@ namespace DeluEngine::GUI
 		template<VariantMember<SizeVariant> Ty>
 		Ty GetFrameSizeAs() const noexcept
 		{
-			return ConvertSizeRepresentation<Ty>(GetLocalSizeAs<AbsoluteSize>(), GetRendererSize());
+			const Rect rect = GetRect();
+			return ConvertSizeRepresentation<Ty>(AbsoluteSize{ rect.topRight.value - rect.bottomLeft.value }, GetRendererSize());
 		}
 
 		template<VariantMember<PositionVariant> Ty>
@@ -475,6 +672,7 @@ namespace DeluEngine::GUI
 					using Inner_Ty = std::remove_cvref_t<decltype(innerVal)>;
 					innerVal = ConvertPositionRepresentation<Inner_Ty>(newVal, GetParentAbsoluteSize());
 				}, m_position, newPos);
+			MarkLayoutDirty();
 		}
 
 		void SetLocalSize(SizeVariant newSize) noexcept
@@ -484,6 +682,7 @@ namespace DeluEngine::GUI
 					using Inner_Ty = std::remove_cvref_t<decltype(innerVal)>;
 					innerVal = ConvertSizeRepresentation<Inner_Ty>(newVal, GetParentAbsoluteSize());
 				}, m_size, newSize);
+			MarkLayoutDirty();
 		}
 
 		void SetFramePosition(PositionVariant newPos) noexcept
@@ -495,6 +694,7 @@ namespace DeluEngine::GUI
 					AbsolutePosition requestedPosition = ConvertPositionRepresentation<AbsolutePosition>(newVal, GetRendererSize());
 					innerVal = ConvertPositionRepresentation<Inner_Ty>(AbsolutePosition{ requestedPosition.value - parentPosition.value }, GetParentAbsoluteSize());
 				}, m_position, newPos);
+			MarkLayoutDirty();
 		}
 
 		void SetFrameSize(SizeVariant newSize) noexcept
@@ -505,16 +705,19 @@ namespace DeluEngine::GUI
 					AbsoluteSize requestedAbsoluteSize = ConvertSizeRepresentation<AbsoluteSize>(newVal, GetRendererSize());
 					innerVal = ConvertSizeRepresentation<Inner_Ty>(requestedAbsoluteSize, GetParentAbsoluteSize());
 				}, m_size, newSize);
+			MarkLayoutDirty();
 		}
 
 		void SetLocalPositionAndRepresentation(PositionVariant val) noexcept
 		{
 			m_position = val;
+			MarkLayoutDirty();
 		}
 
 		void SetLocalSizeAndRepresentation(SizeVariant val) noexcept
 		{
 			m_size = val;
+			MarkLayoutDirty();
 		}
 
 		void SetParent(UIElement* newParent, UIReparentLogic logic = UIReparentLogic::KeepRelativeTransform);
@@ -537,6 +740,7 @@ namespace DeluEngine::GUI
 			default:
 				break;// Should be unreachable
 			}
+			MarkLayoutDirty();
 		}
 
 		AbsoluteSize GetParentAbsoluteSize() const noexcept
@@ -550,13 +754,34 @@ namespace DeluEngine::GUI
 		}
 
 		AbsoluteSize GetRendererSize() const noexcept;
+
+	protected:
+		//Queues the area this element last drew to and the area it now covers for redrawing
+		void MarkDirty() noexcept;
+
+		//Layout changes move every descendant as well
+		void MarkLayoutDirty() noexcept;
+
+	private:
+		Rect ResolveRect() const noexcept;
+
+		//Appends to the end of the parent's children, or of the root elements if there is no parent
+		void Link() noexcept;
+
+		//Does nothing if the element isn't in a sibling list
+		void Unlink() noexcept;
 	};
 
+	ElementIterator& ElementIterator::operator++() noexcept
+	{
+		m_element = m_element->GetNextSibling();
+		return *this;
+	}
+
 	export class Image : public UIElement
 	{
-	public:
-		SDL2pp::shared_ptr<SDL2pp::Texture> texture;
-		bool render = true;
+	private:
+		SDL2pp::shared_ptr<SDL2pp::Texture> m_texture;
 
 	public:
 		Image(GUIEngine& engine) :
@@ -567,8 +792,16 @@ namespace DeluEngine::GUI
 
 		Image(GUIEngine& engine, PositionVariant position, SizeVariant size, xk::Math::Aliases::Vector2 pivot, SDL2pp::shared_ptr<SDL2pp::Texture> texture = nullptr) :
 			UIElement{ engine, position, size, pivot },
-			texture{ texture }
+			m_texture{ texture }
+		{
+		}
+
+		const SDL2pp::shared_ptr<SDL2pp::Texture>& GetTexture() const noexcept { return m_texture; }
+
+		void SetTexture(SDL2pp::shared_ptr<SDL2pp::Texture> texture)
 		{
+			m_texture = std::move(texture);
+			MarkDirty();
 		}
 
 		virtual int HandleEvent(const Event& event);
@@ -576,10 +809,11 @@ namespace DeluEngine::GUI
 
 	export class Button : public UIElement
 	{
+	private:
+		SDL2pp::shared_ptr<SDL2pp::Texture> m_texture;
+
 	public:
-		SDL2pp::shared_ptr<SDL2pp::Texture> texture;
 		std::function<void()> onClicked;
-		bool render = true;
 
 	public:
 		Button(GUIEngine& engine) :
@@ -590,25 +824,32 @@ namespace DeluEngine::GUI
 
 		Button(GUIEngine& engine, PositionVariant position, SizeVariant size, xk::Math::Aliases::Vector2 pivot, SDL2pp::shared_ptr<SDL2pp::Texture> texture = nullptr) :
 			UIElement{ engine, position, size, pivot },
-			texture{ texture }
+			m_texture{ texture }
 		{
 			debugEnableRaytrace = true;
 		}
 
+		const SDL2pp::shared_ptr<SDL2pp::Texture>& GetTexture() const noexcept { return m_texture; }
+
+		void SetTexture(SDL2pp::shared_ptr<SDL2pp::Texture> texture)
+		{
+			m_texture = std::move(texture);
+			MarkDirty();
+		}
+
 		virtual int HandleEvent(const Event& event);
 	};
 
 	export class Text : public UIElement
 	{
 	private:
-		TTF_Font* m_font;
+		Font* m_font = nullptr;
 		std::string m_text;
 		AbsoluteSize m_textBounds;
-		SDL2pp::unique_ptr<SDL2pp::Texture> m_texture;
-		bool m_dirty = true;
 
-	public:
-		bool render = true;
+		//Glyph quads from the font's atlas, rebuilt on change without touching the GPU
+		TextLayout m_layout;
+		bool m_dirty = true;
 
 	public:
 		Text(GUIEngine& engine) :
@@ -622,33 +863,54 @@ namespace DeluEngine::GUI
 		}
 
 		void SetText(std::string_view text);
-		void SetFont(TTF_Font* font)
+		void SetFont(Font* font);
+
+		Rect GetDrawRect() const noexcept override
 		{
-			m_font = font;
-			m_dirty = true;
+			const Rect frameRect = GetRect();
+			const AbsolutePosition topLeft{ { frameRect.bottomLeft.value.X(), frameRect.topRight.value.Y() } };
+			return
+			{
+				AbsolutePosition{ { topLeft.value.X(), topLeft.value.Y() - m_textBounds.value.Y() } },
+				AbsolutePosition{ { topLeft.value.X() + m_textBounds.value.X(), topLeft.value.Y() } }
+			};
 		}
 
 		virtual int HandleEvent(const Event& event);
 	};
 
-	DeluEngine::GUI::UIElement* GetHoveredElement(DeluEngine::GUI::UIElement& element, DeluEngine::GUI::AbsolutePosition mousePos)
+	//Every element flattened in hover priority order and bucketed into a uniform grid over the frame
+	//Priority matches a depth first walk from the last root, children before their parent
+	class HitTestGrid
 	{
-		std::vector<DeluEngine::GUI::UIElement*> children = element.GetChildren();
-		for(DeluEngine::GUI::UIElement* child : children)
-		{
-			if(auto hoveredElement = GetHoveredElement(*child, mousePos); hoveredElement)
-				return hoveredElement;
-		}
+	public:
+		static constexpr float cellSize = 64;
 
-		if(!element.debugEnableRaytrace)
-			return nullptr;
+	private:
 
-		if(element.GetRect().Overlaps(mousePos))
+		//Bounds are split out so scanning a cell touches only contiguous floats
+		struct Cell
 		{
-			return &element;
-		}
-		return nullptr;
-	}
+			std::vector<float> left;
+			std::vector<float> bottom;
+			std::vector<float> right;
+			std::vector<float> top;
+			std::vector<UIElement*> elements;
+		};
+
+		std::vector<UIElement*> m_order;
+		std::vector<Cell> m_cells;
+		xk::Math::Aliases::iVector2 m_cellCount{ 1, 1 };
+
+	public:
+		void Rebuild(UIElement* lastRootElement, AbsoluteSize frameSize);
+
+		//Highest priority raytrace enabled element containing position
+		UIElement* Find(AbsolutePosition position) const noexcept;
+
+	private:
+		xk::Math::Aliases::iVector2 GetCell(xk::Math::Aliases::Vector2 position) const noexcept;
+	};
 
 	struct UIElementDeleter
 	{
@@ -660,47 +922,123 @@ namespace DeluEngine::GUI
 
 	export struct GUIEngine
 	{
+		friend UIElement;
+
 		bool leftClickPressed = false;
 		bool previousLeftClickPressed = false;
 
 		SDL2pp::unique_ptr<SDL2pp::Texture> internalTexture;
 		AbsolutePosition mousePosition;
-		std::vector<UIElement*> rootElements;
 		std::vector<UIElement*> pendingDeletedElements;
 		UIElement* hoveredElement = nullptr;
 		UIElement* previousHoveredElement = nullptr;
 		UIElement* initialLeftClickedElement = nullptr;
 
+		//internalTexture is retained between frames, only the union of dirty areas is cleared and redrawn
+		std::optional<Rect> dirtyRegion;
+		SDL2pp::Texture* retainedTexture = nullptr;
+		std::vector<UIElement*> pendingPrepareElements;
+
+		//Bumped by anything that can move, add, remove or reorder elements
+		std::uint64_t layoutVersion = 0;
+
+		GUIEngine() = default;
+		GUIEngine(const GUIEngine&) = delete;
+		GUIEngine& operator=(const GUIEngine&) = delete;
+
+		//Elements must be released before the engine, anything already released is destroyed here
+		~GUIEngine()
+		{
+			DestroyPendingElements();
+		}
+
 		template<std::derived_from<UIElement> Ty, class... ExtraConstructorParams>
 		UniqueHandle<Ty> NewElement(PositionVariant position, SizeVariant size, xk::Math::Aliases::Vector2 pivot, UIElement* parent = nullptr, ExtraConstructorParams&&... params)
 		{
-			UniqueHandle<Ty> element{ new Ty(*this, position, size, pivot, std::forward<ExtraConstructorParams>(params)...), {} };
-			if(parent)
+			static_assert(ElementPool::CanHold<Ty>, "Element type is over aligned for the element pool");
+
+			void* memory = m_elementPool.Allocate(sizeof(Ty));
+			Ty* newElement;
+			try
 			{
-				element->m_parent = parent;
-				element->m_parent->m_children.push_back(element.get());
+				newElement = new(memory) Ty(*this, position, size, pivot, std::forward<ExtraConstructorParams>(params)...);
 			}
-			else
+			catch(...)
 			{
-				rootElements.push_back(element.get());
+				m_elementPool.Deallocate(memory, sizeof(Ty));
+				throw;
 			}
+
+			UniqueHandle<Ty> element{ newElement, {} };
+			element->m_allocationSize = sizeof(Ty);
+			element->m_parent = parent;
+			element->Link();
+			layoutVersion++;
+			element->MarkDirty();
 			return element;
 		}
 
-		void UpdateHoveredElement()
+		ElementRange GetRootElements() const noexcept { return { m_firstRootElement }; }
+
+		void MarkDirty(const Rect& rect) noexcept
+		{
+			dirtyRegion = dirtyRegion ? dirtyRegion->Union(rect) : rect;
+		}
+
+		void MarkAllDirty() noexcept
+		{
+			MarkDirty(Rect{ AbsolutePosition{}, AbsolutePosition{ GetFrameSize().value } });
+		}
+
+		void QueuePrepareDraw(UIElement& element)
+		{
+			if(std::exchange(element.m_prepareQueued, true))
+				return;
+
+			pendingPrepareElements.push_back(&element);
+		}
+
+		//Brings internalTexture up to date, does nothing to the texture if no element changed since the last call
+		void Redraw(DeluEngine::Renderer& renderer);
+
+		//Destroys every released element in one pass, linear in the number released
+		//Released children of a released element are detached rather than reparented since they go in the same pass
+		void DestroyPendingElements()
 		{
-			if(std::any_of(pendingDeletedElements.begin(), pendingDeletedElements.end(), [this](UIElement* other) { return other == hoveredElement; }))
+			if(hoveredElement && hoveredElement->m_pendingDelete)
 				hoveredElement = nullptr;
+			if(initialLeftClickedElement && initialLeftClickedElement->m_pendingDelete)
+				initialLeftClickedElement = nullptr;
 
 			for(UIElement* element : pendingDeletedElements)
 			{
-				delete element;
+				const std::size_t size = element->m_allocationSize;
+				element->~UIElement();
+				m_elementPool.Deallocate(element, size);
 			}
 			pendingDeletedElements.clear();
+		}
+
+		void UpdateHoveredElement()
+		{
+			DestroyPendingElements();
+
+			previousHoveredElement = hoveredElement;
 
-			previousHoveredElement = std::exchange(hoveredElement, nullptr);
-			for(auto it = rootElements.rbegin(); it != rootElements.rend() && !hoveredElement; it++)
-				hoveredElement = GetHoveredElement(*(*it), mousePosition);
+			//Nothing under the cursor can have changed
+			const std::uint64_t frameVersion = GetFrameVersion();
+			const bool layoutChanged = layoutVersion != m_hitTestLayoutVersion || frameVersion != m_hitTestFrameVersion;
+			if(!layoutChanged && m_hitTestPosition && m_hitTestPosition->value.X() == mousePosition.value.X() && m_hitTestPosition->value.Y() == mousePosition.value.Y())
+				return;
+
+			if(layoutChanged)
+			{
+				m_hitTestGrid.Rebuild(m_lastRootElement, GetFrameSize());
+				m_hitTestLayoutVersion = layoutVersion;
+				m_hitTestFrameVersion = frameVersion;
+			}
+			m_hitTestPosition = mousePosition;
+			hoveredElement = m_hitTestGrid.Find(mousePosition);
 		}
 
 		void DispatchHoveredEvent()
@@ -731,29 +1069,170 @@ namespace DeluEngine::GUI
 			previousLeftClickPressed = leftClickPressed;
 		}
 
+		//Cached per internalTexture so layout queries don't query SDL
 		AbsoluteSize GetFrameSize() const noexcept
 		{
-			return { internalTexture->GetSize() };
+			RefreshFrameSize();
+			return m_frameSize;
 		}
+
+		//Changes whenever the frame size may have, which invalidates every cached element layout
+		std::uint64_t GetFrameVersion() const noexcept
+		{
+			RefreshFrameSize();
+			return m_frameVersion;
+		}
+
+	private:
+		ElementPool m_elementPool;
+		UIElement* m_firstRootElement = nullptr;
+		UIElement* m_lastRootElement = nullptr;
+
+		//Redraw scratch, kept so steady state redraws don't allocate
+		GUIDrawList m_drawList;
+		std::vector<int> m_drawLayers;
+		std::vector<std::size_t> m_drawOrder;
+
+		//Items m_drawLayers and m_drawOrder were assigned for, and the grid used to find their overlaps
+		std::vector<GUIDrawList::Item> m_layeredItems;
+		std::vector<std::vector<std::uint32_t>> m_drawCells;
+		std::vector<SDL2pp::Vertex> m_batchVertices;
+		std::vector<int> m_batchIndices;
+
+		HitTestGrid m_hitTestGrid;
+		std::uint64_t m_hitTestLayoutVersion = 0;
+		std::uint64_t m_hitTestFrameVersion = 0;
+		std::optional<AbsolutePosition> m_hitTestPosition;
+
+		mutable SDL2pp::Texture* m_sizedTexture = nullptr;
+		mutable AbsoluteSize m_frameSize;
+
+		//Starts above 0 so a cleared element version never matches
+		mutable std::uint64_t m_frameVersion = 1;
+
+		void RefreshFrameSize() const noexcept
+		{
+			if(internalTexture.get() == m_sizedTexture)
+				return;
+
+			m_sizedTexture = internalTexture.get();
+			m_frameSize = m_sizedTexture ? AbsoluteSize{ internalTexture->GetSize() } : AbsoluteSize{};
+			m_frameVersion++;
+		}
+
+		void CompileDrawList(DeluEngine::Renderer& renderer, UIElement& element, const Rect& region);
+		void SubmitDrawList(DeluEngine::Renderer& renderer);
+		void AssignDrawLayers();
 	};
 
 	UIElement::~UIElement()
 	{
-		while(!m_children.empty())
+		while(m_lastChild)
+		{
+			UIElement* child = m_lastChild;
+			if(child->m_pendingDelete)
+			{
+				child->Unlink();
+				child->m_parent = nullptr;
+			}
+			else
+			{
+				child->SetParent(m_parent, UIReparentLogic::KeepAbsoluteTransform);
+			}
+		}
+		Unlink();
+		if(m_prepareQueued)
+			std::erase(m_engine->pendingPrepareElements, this);
+		m_engine->layoutVersion++;
+		if(m_drawnRect)
+			m_engine->MarkDirty(*m_drawnRect);
+	}
+
+	void UIElement::MarkDirty() noexcept
+	{
+		if(m_drawnRect)
+			m_engine->MarkDirty(*m_drawnRect);
+		if(m_render)
+			m_engine->MarkDirty(GetDrawRect());
+	}
+
+	void UIElement::MarkLayoutDirty() noexcept
+	{
+		m_layoutVersion = 0;
+		m_engine->layoutVersion++;
+		MarkDirty();
+		for(UIElement* child = m_firstChild; child; child = child->m_nextSibling)
 		{
-			m_children.back()->SetParent(m_parent, UIReparentLogic::KeepAbsoluteTransform);
+			child->MarkLayoutDirty();
 		}
-		SetParent(nullptr);
-		std::erase(m_engine->rootElements, this);
+	}
+
+	void UIElement::Link() noexcept
+	{
+		UIElement*& first = m_parent ? m_parent->m_firstChild : m_engine->m_firstRootElement;
+		UIElement*& last = m_parent ? m_parent->m_lastChild : m_engine->m_lastRootElement;
+		m_previousSibling = last;
+		m_nextSibling = nullptr;
+		(last ? last->m_nextSibling : first) = this;
+		last = this;
+	}
+
+	void UIElement::Unlink() noexcept
+	{
+		UIElement*& first = m_parent ? m_parent->m_firstChild : m_engine->m_firstRootElement;
+		UIElement*& last = m_parent ? m_parent->m_lastChild : m_engine->m_lastRootElement;
+		if(!m_previousSibling && first != this)
+			return;
+
+		(m_previousSibling ? m_previousSibling->m_nextSibling : first) = m_nextSibling;
+		(m_nextSibling ? m_nextSibling->m_previousSibling : last) = m_previousSibling;
+		m_previousSibling = nullptr;
+		m_nextSibling = nullptr;
+	}
+
+	void UIElement::SetRaytrace(bool raytrace) noexcept
+	{
+		if(debugEnableRaytrace == raytrace)
+			return;
+
+		debugEnableRaytrace = raytrace;
+		m_engine->layoutVersion++;
 	}
 
 	AbsoluteSize DeluEngine::GUI::UIElement::GetRendererSize() const noexcept
 	{
 		return m_engine->GetFrameSize();
 	}
+
+	Rect UIElement::GetRect() const noexcept
+	{
+		const std::uint64_t frameVersion = m_engine->GetFrameVersion();
+		if(m_layoutVersion != frameVersion)
+		{
+			m_layoutRect = ResolveRect();
+			m_layoutVersion = frameVersion;
+		}
+		return m_layoutRect;
+	}
+
+	//Only reads the parent's cached rect, so resolving a whole tree is linear in its size
+	Rect UIElement::ResolveRect() const noexcept
+	{
+		const Rect parentRect = m_parent ? m_parent->GetRect() : Rect{ AbsolutePosition{}, AbsolutePosition{ GetRendererSize().value } };
+		const AbsoluteSize parentSize{ parentRect.topRight.value - parentRect.bottomLeft.value };
+
+		const xk::Math::Aliases::Vector2 size = std::visit([parentSize](const auto& val) { return ConvertSizeRepresentation<AbsoluteSize>(val, parentSize).value; }, m_size);
+		const xk::Math::Aliases::Vector2 position = std::visit([parentSize](const auto& val) { return ConvertPositionRepresentation<AbsolutePosition>(val, parentSize).value; }, m_position);
+		const xk::Math::Aliases::Vector2 pivotOffset = { m_pivot.X() * -size.X(), m_pivot.Y() * -size.Y() };
+		const xk::Math::Aliases::Vector2 parentPosition = m_parent ? parentRect.bottomLeft.value : xk::Math::Aliases::Vector2{};
+
+		const AbsolutePosition bottomLeft{ position + parentPosition + pivotOffset };
+		return { bottomLeft, AbsolutePosition{ bottomLeft.value + size } };
+	}
 	
 	void UIElementDeleter::operator()(UIElement* element)
 	{
+		element->m_pendingDelete = true;
 		element->m_engine->pendingDeletedElements.push_back(element);
 	}
 
@@ -1,6 +1,7 @@
 module;
 
 #include <chrono>
+#include <cmath>
 #include <string_view>
 #include <vector>
 #include <string>
@@ -10,8 +11,20 @@ module;
 #include <functional>
 #include <unordered_map>
 #include <gsl/pointers>
+#include <variant>
+#include <algorithm>
+#include <atomic>
+#include <span>
+#include <stdexcept>
+#include <limits>
+#include <utility>
+#include "ProfilerMacros.h"
 
 export module DeluEngine:Heart;
+import xk.JobSystem;
+import xk.Profiler;
+import xk.ScopeGuard;
+import :TimerWheel;
 
 namespace DeluEngine
 {
@@ -20,23 +33,91 @@ namespace DeluEngine
 
 	export class PulseCallback;
 
+	//Runs once per Heart::Pulse with however much time passed since the last one
+	export struct VariableRate
+	{
+	};
+
+	//Runs in steps of exactly 1 / hz, as many as fit into the time passed
+	//hz must be finite and positive with a step of at least a nanosecond, and at least one step must be allowed per Pulse
+	export struct FixedRate
+	{
+		double hz;
+
+		//Steps allowed in one Pulse, time beyond that is dropped so a slow frame can't snowball into slower ones
+		int maxStepsPerPulse = 5;
+	};
+
+	export using PulseRate = std::variant<VariableRate, FixedRate>;
+
+	export struct PulseGroupOptions
+	{
+		PulseRate rate = VariableRate{};
+
+		//Runs on a job system worker alongside its concurrent siblings, exclusive groups run alone on the pulsing thread
+		//Callbacks of a concurrent group run on whichever worker picks it up
+		bool concurrent = false;
+
+		//Full names of sibling groups that must finish first, they must already be registered with a priority no higher
+		std::vector<std::string> dependencies;
+	};
 
 	export class PulseGroup
 	{
+		friend class Heart;
+
 	private:
 		std::int16_t priority;
 		float timeMultiplier = 1;
 		std::vector<std::unique_ptr<PulseGroup>> m_childGroups;
 		std::string name;
+		PulseRate m_rate;
+		std::chrono::nanoseconds m_accumulator{ 0 };
+		bool m_concurrent = false;
+		std::vector<PulseGroup*> m_dependencies;
+		std::vector<PulseGroup*> m_dependents;
+
+		//Dependencies in the current run of concurrent siblings that haven't finished this pulse
+		std::atomic<std::uint32_t> m_remainingDependencies{ 0 };
+		TimerWheel m_timers;
 
 		std::vector<gsl::not_null<PulseCallback*>> callbacks;
 
+		struct Delegate
+		{
+			void* object;
+			void(*function)(void*, std::chrono::nanoseconds);
+		};
+
+		static constexpr std::uint32_t noDelegate = std::numeric_limits<std::uint32_t>::max();
+
+		//Packed so a pulse sweeps them in order, removal swaps the last one into the gap
+		std::vector<Delegate> m_delegates;
+		std::vector<std::uint32_t> m_delegateIds;
+
+		//Index into m_delegates for each live id, free ids are chained through it instead
+		std::vector<std::uint32_t> m_delegateIndices;
+		std::uint32_t m_freeDelegateId = noDelegate;
+
+		//Delegates removed during the sweep are nulled and only erased once it's done
+		bool m_sweepingDelegates = false;
+		std::vector<std::uint32_t> m_deferredDelegateRemovals;
+
 	public:
-		PulseGroup(std::string name, int16_t priority) :
+		PulseGroup(std::string name, int16_t priority, PulseRate rate = VariableRate{}, bool concurrent = false) :
 			priority{ priority },
-			name{ name }
+			name{ name },
+			m_rate{ rate },
+			m_concurrent{ concurrent }
 		{
-
+			const FixedRate* fixedRate = std::get_if<FixedRate>(&m_rate);
+			if(!fixedRate)
+				return;
+
+			if(!std::isfinite(fixedRate->hz) || fixedRate->hz <= 0 || 1 / fixedRate->hz < 1e-9)
+				throw std::invalid_argument("Pulse group " + this->name + " has an invalid fixed rate of " + std::to_string(fixedRate->hz) + "hz");
+			if(fixedRate->maxStepsPerPulse < 1)
+				throw std::invalid_argument("Pulse group " + this->name + " must allow at least one step per pulse");
 		}
 
 		void AddPulseCallback(gsl::not_null<PulseCallback*> callback)
@@ -51,8 +132,14 @@ namespace DeluEngine
 
 		void AddChildGroup(std::unique_ptr<PulseGroup> group)
 		{
-			m_childGroups.push_back(std::move(group));
-			std::push_heap(m_childGroups.begin(), m_childGroups.end(), [](const auto& lh, const auto& rh) { return std::greater()(lh->GetPriority(), rh->GetPriority()); });
+			InsertByPriority(m_childGroups, std::move(group));
+		}
+
+		//Only meaningful for concurrent groups, exclusive groups already start after every sibling before them
+		void AddDependency(PulseGroup& group)
+		{
+			m_dependencies.push_back(&group);
+			group.m_dependents.push_back(this);
 		}
 
 		void ClearCallbacks()
@@ -60,9 +147,99 @@ namespace DeluEngine
 			callbacks.clear();
 		}
 
-		void Pulse(std::chrono::nanoseconds deltaTime);
+		//Registers object.*Function(deltaTime) without a virtual call or a heap allocation
+		//Delegates run after the group's callbacks, in no particular order among themselves
+		//Delegates added during a pulse first run on the next one
+		template<auto Function, class Ty>
+		std::uint32_t AddDelegate(Ty& object)
+		{
+			return AddDelegate({ &object, [](void* object, std::chrono::nanoseconds deltaTime) { std::invoke(Function, *static_cast<Ty*>(object), deltaTime); } });
+		}
+
+		void RemoveDelegate(std::uint32_t id)
+		{
+			const std::uint32_t index = m_delegateIndices[id];
+			if(m_sweepingDelegates)
+			{
+				m_delegates[index].function = nullptr;
+				m_deferredDelegateRemovals.push_back(id);
+				return;
+			}
+
+			const std::uint32_t lastId = m_delegateIds.back();
+			m_delegates[index] = m_delegates.back();
+			m_delegateIds[index] = lastId;
+			m_delegateIndices[lastId] = index;
+			m_delegates.pop_back();
+			m_delegateIds.pop_back();
+
+			m_delegateIndices[id] = m_freeDelegateId;
+			m_freeDelegateId = id;
+		}
+
+		void Pulse(std::chrono::nanoseconds deltaTime, xk::JobSystem* jobSystem = nullptr);
 		
 		std::int16_t GetPriority() const noexcept { return priority; }
+
+		//Scales the time passed to callbacks, delegates and timers of this group and its children, 0 pauses them
+		void SetTimeMultiplier(float multiplier) noexcept { timeMultiplier = multiplier; }
+		float GetTimeMultiplier() const noexcept { return timeMultiplier; }
+
+		//Advanced by the group's scaled time, timers fire before the group's callbacks
+		//Only schedule from this group's own pulse or while it isn't pulsing, concurrent groups pulse on workers
+		TimerWheel& GetTimers() noexcept { return m_timers; }
+
+		//How far between the last fixed step and the next one the present is, for interpolating rendered state
+		//Always 1 for variable rate groups as their state is current
+		float GetInterpolationAlpha() const noexcept
+		{
+			if(const FixedRate* rate = std::get_if<FixedRate>(&m_rate))
+				return std::chrono::duration<float>(m_accumulator).count() * static_cast<float>(rate->hz);
+			return 1;
+		}
+
+	private:
+		void Step(std::chrono::nanoseconds deltaTime, xk::JobSystem* jobSystem);
+
+		std::uint32_t AddDelegate(Delegate delegate)
+		{
+			std::uint32_t id = m_freeDelegateId;
+			if(id != noDelegate)
+			{
+				m_freeDelegateId = m_delegateIndices[id];
+			}
+			else
+			{
+				id = static_cast<std::uint32_t>(m_delegateIndices.size());
+				m_delegateIndices.push_back(0);
+			}
+
+			m_delegateIndices[id] = static_cast<std::uint32_t>(m_delegates.size());
+			m_delegates.push_back(delegate);
+			m_delegateIds.push_back(id);
+			return id;
+		}
+
+		void SweepDelegates(std::chrono::nanoseconds deltaTime);
+
+		//Equal priorities keep their registration order
+		static void InsertByPriority(std::vector<std::unique_ptr<PulseGroup>>& groups, std::unique_ptr<PulseGroup> group)
+		{
+			auto it = std::upper_bound(groups.begin(), groups.end(), group->GetPriority(), [](std::int16_t priority, const auto& other) { return priority < other->GetPriority(); });
+			groups.insert(it, std::move(group));
+		}
+
+		//Pulses sorted siblings, every concurrent group is joined before the next exclusive one and before returning
+		static void PulseSiblings(std::span<const std::unique_ptr<PulseGroup>> groups, std::chrono::nanoseconds deltaTime, xk::JobSystem* jobSystem);
+
+		//Pulses consecutive concurrent siblings, each one starts as soon as the last of its dependencies among them finishes
+		static void PulseConcurrent(std::span<const std::unique_ptr<PulseGroup>> run, std::chrono::nanoseconds deltaTime, xk::JobSystem& jobSystem);
+		void Launch(std::span<const std::unique_ptr<PulseGroup>> run, std::chrono::nanoseconds deltaTime, xk::JobSystem& jobSystem, xk::JobCounter& counter);
+
+		static bool Contains(std::span<const std::unique_ptr<PulseGroup>> run, const PulseGroup* group) noexcept
+		{
+			return std::ranges::any_of(run, [group](const auto& other) { return other.get() == group; });
+		}
 	};
 
 	export class Heart
@@ -70,50 +247,83 @@ namespace DeluEngine
 	private:
 		std::chrono::steady_clock::time_point previousTick = std::chrono::steady_clock::now();
 		std::vector<std::unique_ptr<PulseGroup>> rootGroups;
-		std::unordered_map<std::string, PulseGroup*> lookUpCache;
+		struct NameHash
+		{
+			using is_transparent = void;
+			std::size_t operator()(std::string_view name) const noexcept { return std::hash<std::string_view>{}(name); }
+		};
+
+		//Transparent so looking a group up by a string_view doesn't build a std::string
+		std::unordered_map<std::string, PulseGroup*, NameHash, std::equal_to<>> lookUpCache;
 
 	public:
-		void RegisterGroup(std::string_view name, std::int16_t priority)
+		void RegisterGroup(std::string_view name, std::int16_t priority, PulseRate rate = VariableRate{})
+		{
+			RegisterGroup(name, priority, PulseGroupOptions{ .rate = rate });
+		}
+
+		void RegisterGroup(std::string_view name, std::int16_t priority, PulseGroupOptions options)
 		{
 			auto index = name.rfind('.');
-			if(index != std::string_view::npos)
+			auto group = std::make_unique<PulseGroup>(std::string{ index != std::string_view::npos ? name.substr(index + 1) : name }, priority, options.rate, options.concurrent);
+			const std::string_view parentName = index != std::string_view::npos ? name.substr(0, index) : std::string_view{};
+
+			for(const std::string& dependencyName : options.dependencies)
 			{
-				auto group = std::make_unique<PulseGroup>(std::string{ name.substr(index + 1) }, priority);
-				lookUpCache.insert({ std::string{ name }, group.get() });
-				lookUpCache.at(std::string{ name.substr(0, index) })->AddChildGroup(std::move(group));
+				const auto dependencyIndex = dependencyName.rfind('.');
+				const std::string_view dependencyParent = dependencyIndex != std::string::npos ? std::string_view{ dependencyName }.substr(0, dependencyIndex) : std::string_view{};
+				if(dependencyParent != parentName)
+					throw std::logic_error("Pulse group " + std::string{ name } + " can only depend on its siblings, not " + dependencyName);
+
+				PulseGroup& dependency = GetGroup(dependencyName);
+				if(dependency.GetPriority() > priority)
+					throw std::logic_error("Pulse group " + std::string{ name } + " depends on " + dependencyName + " which runs after it");
+				group->AddDependency(dependency);
 			}
+
+			lookUpCache.insert({ std::string{ name }, group.get() });
+			if(index != std::string_view::npos)
+				GetGroup(parentName).AddChildGroup(std::move(group));
 			else
-			{
-				rootGroups.push_back(std::make_unique<PulseGroup>(std::string{ name }, priority));
-				lookUpCache.insert({ std::string{ name }, rootGroups.back().get() });
-				std::push_heap(rootGroups.begin(), rootGroups.end(), [](const auto& lh, const auto& rh) { return std::greater()(lh->GetPriority(), rh->GetPriority()); });
-			}
+				PulseGroup::InsertByPriority(rootGroups, std::move(group));
+		}
+
+		//Groups live as long as the heart, so the result can be kept instead of looking the name up again
+		PulseGroup& GetGroup(std::string_view name) const
+		{
+			auto it = lookUpCache.find(name);
+			if(it == lookUpCache.end())
+				throw std::out_of_range("No pulse group named " + std::string{ name });
+			return *it->second;
 		}
 
 		void RegisterCallback(std::string_view name, gsl::not_null<PulseCallback*> callback)
 		{
-			lookUpCache.at(std::string{ name })->AddPulseCallback(callback);
+			GetGroup(name).AddPulseCallback(callback);
 		}
 
 		void RemoveCallback(std::string_view name, gsl::not_null<PulseCallback*> callback)
 		{
-			lookUpCache.at(std::string{ name })->RemovePulseCallback(callback);
+			GetGroup(name).RemovePulseCallback(callback);
 		}
 
 		void ClearCallbacks(std::string_view name)
 		{
-			lookUpCache.at(std::string{ name })->ClearCallbacks();
+			GetGroup(name).ClearCallbacks();
 		}
 
-		void Pulse()
+		float GetInterpolationAlpha(std::string_view name) const
+		{
+			return GetGroup(name).GetInterpolationAlpha();
+		}
+
+		//Without a job system concurrent groups run inline like exclusive ones
+		void Pulse(xk::JobSystem* jobSystem = nullptr)
 		{
 			auto currentTick = std::chrono::steady_clock::now();
 			auto delta = currentTick - previousTick;
 
-			for(auto& pulseGroup : rootGroups)
-			{
-				pulseGroup->Pulse(delta);
-			}
+			PulseGroup::PulseSiblings(rootGroups, delta, jobSystem);
 
 			previousTick = currentTick;
 		}
@@ -124,57 +334,234 @@ namespace DeluEngine
 	export class PulseCallback
 	{
 	private:
-		Heart* m_heart;
-		std::string m_groupName;
+		PulseGroup* m_group;
+		const char* m_name;
 
 	public:
-		PulseCallback(std::string groupName, Heart& heart = gHeart) :
-			m_heart{ &heart },
-			m_groupName{ groupName }
+		//name labels the callback in profiler traces and must outlive the profiler
+		PulseCallback(std::string_view groupName, const char* name, Heart& heart = gHeart) :
+			PulseCallback{ heart.GetGroup(groupName), name }
+		{
+
+		}
+
+		PulseCallback(PulseGroup& group, const char* name) :
+			m_group{ &group },
+			m_name{ name }
 		{
-			m_heart->RegisterCallback(m_groupName, this);
+			m_group->AddPulseCallback(this);
 		}
 		PulseCallback(const PulseCallback&) = delete;
 
 		//On moves there is no need to remove the callback as it is assumed
 		//that other will be falling out of scope soon therefore destructor running and removing the callback
 		PulseCallback(PulseCallback&& other) noexcept :
-			m_heart{ other.m_heart },
-			m_groupName{ other.m_groupName }
+			m_group{ other.m_group },
+			m_name{ other.m_name }
 		{
-			m_heart->RegisterCallback(m_groupName, this);
+			m_group->AddPulseCallback(this);
 		}
 
 		virtual void Update(std::chrono::nanoseconds deltaTime) = 0;
 
+		const char* GetName() const noexcept { return m_name; }
+
 	protected:
 		PulseCallback& operator=(const PulseCallback&) = delete;
 		PulseCallback& operator=(PulseCallback&&) noexcept = default;
 
 		~PulseCallback()
 		{
-			m_heart->RemoveCallback(m_groupName, this);
+			m_group->RemovePulseCallback(this);
 		}
 	};
 
-	void PulseGroup::Pulse(std::chrono::nanoseconds deltaTime)
+	//Owns a delegate registered on a pulse group and removes it when destroyed
+	export class UniquePulseDelegate
+	{
+	private:
+		PulseGroup* m_group = nullptr;
+		std::uint32_t m_id = 0;
+
+	public:
+		UniquePulseDelegate() = default;
+
+		template<auto Function, class Ty>
+		static UniquePulseDelegate Create(PulseGroup& group, Ty& object)
+		{
+			UniquePulseDelegate delegate;
+			delegate.m_id = group.AddDelegate<Function>(object);
+			delegate.m_group = &group;
+			return delegate;
+		}
+
+		UniquePulseDelegate(const UniquePulseDelegate&) = delete;
+		UniquePulseDelegate(UniquePulseDelegate&& other) noexcept :
+			m_group{ std::exchange(other.m_group, nullptr) },
+			m_id{ other.m_id }
+		{
+
+		}
+
+		UniquePulseDelegate& operator=(const UniquePulseDelegate&) = delete;
+		UniquePulseDelegate& operator=(UniquePulseDelegate&& other) noexcept
+		{
+			Reset();
+			m_group = std::exchange(other.m_group, nullptr);
+			m_id = other.m_id;
+			return *this;
+		}
+
+		~UniquePulseDelegate()
+		{
+			Reset();
+		}
+
+		void Reset()
+		{
+			if(m_group)
+				std::exchange(m_group, nullptr)->RemoveDelegate(m_id);
+		}
+
+		explicit operator bool() const noexcept { return m_group; }
+	};
+
+	void PulseGroup::Pulse(std::chrono::nanoseconds deltaTime, xk::JobSystem* jobSystem)
 	{
 		deltaTime *= timeMultiplier;
 
-		std::size_t i = 0;
-		for(; i < m_childGroups.size() && m_childGroups[i]->priority <= 0; i++)
+		const FixedRate* rate = std::get_if<FixedRate>(&m_rate);
+		if(!rate)
 		{
-			m_childGroups[i]->Pulse(deltaTime);
+			Step(deltaTime, jobSystem);
+			return;
 		}
 
+		const auto step = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(1 / rate->hz));
+		m_accumulator += deltaTime;
+		for(int i = 0; i < rate->maxStepsPerPulse && m_accumulator >= step; i++)
+		{
+			Step(step, jobSystem);
+			m_accumulator -= step;
+		}
+
+		//Behind by more than the cap allows, keep only the partial step so the alpha stays meaningful
+		if(m_accumulator >= step)
+			m_accumulator %= step;
+	}
+
+	void PulseGroup::Step(std::chrono::nanoseconds deltaTime, xk::JobSystem* jobSystem)
+	{
+		XK_PROFILE_ZONE(name.c_str());
+		auto firstAfterCallbacks = std::partition_point(m_childGroups.begin(), m_childGroups.end(), [](const auto& group) { return group->priority <= 0; });
+		const std::span<const std::unique_ptr<PulseGroup>> children = m_childGroups;
+		const auto split = static_cast<std::size_t>(firstAfterCallbacks - m_childGroups.begin());
+
+		PulseSiblings(children.first(split), deltaTime, jobSystem);
+		m_timers.Advance(deltaTime);
+
 		for(auto& callback : callbacks)
 		{
+			XK_PROFILE_ZONE(callback->GetName());
 			callback->Update(deltaTime);
 		}
+		SweepDelegates(deltaTime);
+
+		PulseSiblings(children.subspan(split), deltaTime, jobSystem);
+	}
+
+	void PulseGroup::SweepDelegates(std::chrono::nanoseconds deltaTime)
+	{
+		if(m_delegates.empty())
+			return;
+
+		XK_PROFILE_ZONE("PulseDelegates");
 
-		for(; i < m_childGroups.size(); i++)
+		//Indexed as delegates may add more and reallocate, those are left for the next pulse
+		m_sweepingDelegates = true;
+		xk::ScopeExit finishSweep{ [this]
+			{
+				m_sweepingDelegates = false;
+				for(std::uint32_t id : m_deferredDelegateRemovals)
+				{
+					RemoveDelegate(id);
+				}
+				m_deferredDelegateRemovals.clear();
+			} };
+
+		for(std::size_t i = 0, count = m_delegates.size(); i < count; i++)
 		{
-			m_childGroups[i]->Pulse(deltaTime);
+			const Delegate delegate = m_delegates[i];
+			if(delegate.function)
+				delegate.function(delegate.object, deltaTime);
 		}
 	}
+
+	void PulseGroup::PulseSiblings(std::span<const std::unique_ptr<PulseGroup>> groups, std::chrono::nanoseconds deltaTime, xk::JobSystem* jobSystem)
+	{
+		if(!jobSystem)
+		{
+			for(auto& group : groups)
+			{
+				group->Pulse(deltaTime, nullptr);
+			}
+			return;
+		}
+
+		for(std::size_t i = 0; i < groups.size();)
+		{
+			if(!groups[i]->m_concurrent)
+			{
+				groups[i]->Pulse(deltaTime, jobSystem);
+				i++;
+				continue;
+			}
+
+			std::size_t end = i + 1;
+			while(end < groups.size() && groups[end]->m_concurrent)
+			{
+				end++;
+			}
+			PulseConcurrent(groups.subspan(i, end - i), deltaTime, *jobSystem);
+			i = end;
+		}
+	}
+
+	void PulseGroup::PulseConcurrent(std::span<const std::unique_ptr<PulseGroup>> run, std::chrono::nanoseconds deltaTime, xk::JobSystem& jobSystem)
+	{
+		//Dependencies outside the run are earlier siblings, joined before the exclusive group that ended their run
+		auto countDependencies = [run](const PulseGroup& group)
+			{
+				return static_cast<std::uint32_t>(std::ranges::count_if(group.m_dependencies, [run](const PulseGroup* dependency) { return Contains(run, dependency); }));
+			};
+
+		for(const auto& group : run)
+		{
+			group->m_remainingDependencies.store(countDependencies(*group), std::memory_order_relaxed);
+		}
+
+		//Counted again rather than read back, groups launched here may already have released their dependents
+		xk::JobCounter counter;
+		for(const auto& group : run)
+		{
+			if(countDependencies(*group) == 0)
+				group->Launch(run, deltaTime, jobSystem, counter);
+		}
+		jobSystem.Wait(counter);
+	}
+
+	//The last dependency to finish starts its dependent, so no thread ever waits on a particular group
+	void PulseGroup::Launch(std::span<const std::unique_ptr<PulseGroup>> run, std::chrono::nanoseconds deltaTime, xk::JobSystem& jobSystem, xk::JobCounter& counter)
+	{
+		jobSystem.Run(counter, [this, run, deltaTime, &jobSystem, &counter]
+			{
+				Pulse(deltaTime, &jobSystem);
+				for(PulseGroup* dependent : m_dependents)
+				{
+					//Dependents past the next exclusive sibling are started by their own run
+					if(Contains(run, dependent) && dependent->m_remainingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+						dependent->Launch(run, deltaTime, jobSystem, counter);
+				}
+			});
+	}
 }
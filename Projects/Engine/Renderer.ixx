@@ -11,52 +11,79 @@ module;
 #include <span>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <unordered_map>
+#include <map>
+#include <concepts>
+#include "ProfilerMacros.h"
 
 export module DeluEngine:Renderer;
 export import SDL2pp;
 import xk.Math.Angles;
 import xk.Math.Matrix;
 import xk.Math.Color;
+import xk.Profiler;
 
 namespace DeluEngine
 {
 	export class Renderer;
 
-	export struct SpriteData
+	//Index into the renderer's sprite sheet table
+	export using SpriteSheetIndex = std::uint32_t;
+
+	//A single texture shared by every sprite cut out of it
+	export struct SpriteSheet
 	{
 		SDL2pp::shared_ptr<SDL2pp::Texture> texture;
-		SDL2pp::Rect drawRect;
+		std::vector<SDL2pp::Rect> rects;
 	};
 
-	export class Sprite
+	export struct SpriteData
 	{
-	public:
-		xk::Math::Aliases::Vector2 position;
-		xk::Math::Degree<float> angle;
+		SpriteSheetIndex sheet = 0;
+		std::uint32_t rect = 0;
+		SDL2pp::BlendMode blendMode = SDL_BLENDMODE_BLEND;
+	};
 
-	private:
-		gsl::not_null<Renderer*> m_owningRenderer;
-		std::shared_ptr<SpriteData> m_data;
+	//Index into the renderer's sprite data table
+	export using SpriteDataIndex = std::uint32_t;
 
-	public:
-		Sprite(gsl::not_null<Renderer*> spriteRenderer, std::shared_ptr<SpriteData> spriteData) :
-			m_owningRenderer(spriteRenderer),
-			m_data(std::move(spriteData))
-		{
-		}
+	//Shared ownership of a sprite sheet or sprite data entry, released along with its last reference
+	export template<class Ty>
+	class RendererRef;
 
-	public:
-		void SetSpriteData(std::shared_ptr<SpriteData> data);
+	export using SpriteSheetRef = RendererRef<SpriteSheet>;
+	export using SpriteDataRef = RendererRef<SpriteData>;
 
-		SpriteData* GetSpriteData() const noexcept
-		{
-			return m_data.get();
-		}
+	//Generational handle to a sprite owned by a Renderer, stale handles are detected instead of aliasing a new sprite
+	export struct SpriteHandle
+	{
+		static constexpr std::uint32_t invalidIndex = std::numeric_limits<std::uint32_t>::max();
 
-		std::shared_ptr<SpriteData> GetSpriteDataShared() const noexcept
-		{
-			return m_data;
-		}
+		std::uint32_t index = invalidIndex;
+		std::uint32_t generation = 0;
+
+		bool IsNull() const noexcept { return index == invalidIndex; }
+
+		friend bool operator==(const SpriteHandle&, const SpriteHandle&) noexcept = default;
+	};
+
+	//Read only view over the dense sprite arrays, every span is indexed by the same dense index
+	export struct SpriteSpan
+	{
+		std::span<const xk::Math::Aliases::Vector2> positions;
+		std::span<const xk::Math::Degree<float>> angles;
+		std::span<const std::int32_t> layers;
+		std::span<const SpriteDataIndex> spriteData;
+
+		std::size_t size() const noexcept { return positions.size(); }
 	};
 
 	export class DebugRenderer
@@ -85,26 +112,108 @@ namespace DeluEngine
 		}
 	};
 
+	//Size of the surface a headless renderer draws into
+	export struct OffscreenTarget
+	{
+		xk::Math::Aliases::iVector2 size;
+	};
+
+	export struct RenderStats
+	{
+		std::size_t drawCalls = 0;
+		std::size_t spritesDrawn = 0;
+	};
+
 	export class Renderer
 	{
+		template<class Ty>
+		friend class RendererRef;
+
 	private:
-		struct SpriteDeleter
+		struct SpriteSlot
+		{
+			//Dense index while the slot is alive, next free slot while it is on the free list
+			std::uint32_t denseIndex;
+			std::uint32_t generation;
+
+			//Spatial grid bucket the sprite is in and its position within that bucket
+			std::uint64_t cell;
+			std::uint32_t cellIndex;
+
+			//Bounding radius the sprite was counted under in m_radiusCounts
+			float radius;
+
+			//When the sprite was created, unlike the dense index it survives other sprites being destroyed
+			std::uint64_t sequence;
+		};
+
+		struct SpriteBounds
 		{
-			Renderer* renderer;
-			void operator()(Sprite* sprite) { renderer->DeleteSprite(sprite); }
+			xk::Math::Aliases::Vector2 center;
+			float radius;
+		};
+
+		struct SpriteSortKey
+		{
+			std::int32_t layer;
+			SDL2pp::Texture* texture;
+			SDL2pp::BlendMode blendMode;
+			std::uint64_t sequence;
+			std::uint32_t denseIndex;
 		};
 
 	public:
-		using SpriteHandle = std::unique_ptr<Sprite, SpriteDeleter>;
+		static constexpr SpriteSheetIndex emptySpriteSheet = 0;
+		static constexpr SpriteDataIndex defaultSpriteData = 0;
+
+		//Sprites are bucketed by the cell their center falls in, queries expand by the largest radius currently in the grid
+		static constexpr float spatialCellSize = 256.f;
 
 	private:
-		std::vector<Sprite*> m_sprites;
+		std::vector<SpriteSheet> m_spriteSheets{ 1 };
+		std::vector<SpriteData> m_spriteData{ 1 };
+
+		//Held by refs, sprite data holds its sheet and sprites hold their data
+		//The empty sheet and default data are never released so their counts are left alone
+		std::vector<std::uint32_t> m_spriteSheetRefs{ 1 };
+		std::vector<std::uint32_t> m_spriteDataRefs{ 1 };
+		std::vector<SpriteSheetIndex> m_freeSpriteSheets;
+		std::vector<SpriteDataIndex> m_freeSpriteData;
+
+		std::vector<SpriteSlot> m_spriteSlots;
+		std::uint32_t m_freeSpriteSlot = SpriteHandle::invalidIndex;
+		std::uint64_t m_nextSpriteSequence = 0;
+
+		//Dense sprite storage, kept packed by swapping the last sprite into destroyed entries
+		std::vector<xk::Math::Aliases::Vector2> m_positions;
+		std::vector<xk::Math::Degree<float>> m_angles;
+		std::vector<std::int32_t> m_layers;
+		std::vector<SpriteDataIndex> m_spriteDataIndices;
+		std::vector<std::uint32_t> m_denseToSlot;
+
+		//Loose uniform grid of slot indices used for culling and region queries
+		//Buckets are erased once empty so the grid only holds occupied cells
+		std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> m_spatialGrid;
+
+		//How many sprites in the grid have each bounding radius, the largest one pads region queries
+		std::map<float, std::uint32_t> m_radiusCounts;
+
+		//Only set for headless renderers, must outlive backend
+		SDL2pp::unique_ptr<SDL2pp::Surface> m_offscreenSurface;
+
+		//Per frame scratch buffers, kept around so batching doesn't allocate once warmed up
+		std::vector<SpriteSortKey> m_sortKeys;
+		std::vector<SDL2pp::Vertex> m_batchVertices;
+		std::vector<int> m_batchIndices;
 
 	public:
-		std::shared_ptr<SpriteData> defaultSpriteData;
 		SDL2pp::unique_ptr<SDL2pp::Renderer> backend;
 		SDL2pp::Color clearColor = SDL2pp::Color{ { 96.f, 128, 255, 255 } };
 		std::vector<std::function<void(DebugRenderer&)>> debugCallbacks;
+
+		//Accumulates until reset by whoever is measuring
+		RenderStats stats;
+
 	public:
 		Renderer(SDL2pp::view_ptr<SDL2pp::Window> window, int deviceIndex = -1, SDL2pp::RendererFlag flags = SDL2pp::RendererFlag::Accelerated) :
 			backend(SDL2pp::CreateRenderer(window, deviceIndex, flags))
@@ -112,11 +221,142 @@ namespace DeluEngine
 			TTF_Init();
 		}
 
-		SpriteHandle CreateSprite(std::shared_ptr<SpriteData> spriteData)
+		//Headless renderer drawing into a software surface, usable without a display
+		Renderer(OffscreenTarget target) :
+			m_offscreenSurface(SDL2pp::CreateSurface(target.size, SDL_PIXELFORMAT_RGBA32)),
+			backend(SDL2pp::CreateSoftwareRenderer(m_offscreenSurface.get()))
+		{
+			TTF_Init();
+		}
+
+		bool IsHeadless() const noexcept { return static_cast<bool>(m_offscreenSurface); }
+
+		//The sheet's texture is released once the ref and all sprite data cut out of it are gone
+		SpriteSheetRef AddSpriteSheet(SpriteSheet sheet);
+
+		const SpriteSheet& GetSpriteSheet(SpriteSheetIndex index) const
 		{
-			SpriteHandle sprite{ new Sprite(this, spriteData ? std::move(spriteData) : defaultSpriteData), SpriteDeleter{this} };
-			m_sprites.push_back(sprite.get());
-			return sprite;
+			return m_spriteSheets.at(index);
+		}
+
+		//Keeps its sheet alive for as long as the ref or any sprite using the data is
+		SpriteDataRef AddSpriteData(SpriteData data);
+
+		void SetDefaultSpriteData(SpriteData data)
+		{
+			if(!IsSheetRectValid(data))
+				throw std::out_of_range("Sprite data does not reference a valid sprite sheet rect");
+
+			AddSheetRef(data.sheet);
+			ReleaseSheet(std::exchange(m_spriteData[defaultSpriteData], std::move(data)).sheet);
+
+			//Bounds of every sprite using the default data may have changed
+			for(std::uint32_t i = 0; i < m_spriteDataIndices.size(); i++)
+			{
+				if(m_spriteDataIndices[i] == defaultSpriteData)
+					UpdateGrid(m_denseToSlot[i]);
+			}
+		}
+
+		const SpriteData& GetSpriteData(SpriteDataIndex index) const
+		{
+			return m_spriteData.at(index);
+		}
+
+		SpriteHandle CreateSprite(SpriteDataIndex spriteData = defaultSpriteData)
+		{
+			if(!IsSpriteDataAlive(spriteData))
+				throw std::out_of_range("Sprite data index out of range");
+
+			std::uint32_t slotIndex;
+			if(m_freeSpriteSlot != SpriteHandle::invalidIndex)
+			{
+				slotIndex = m_freeSpriteSlot;
+				m_freeSpriteSlot = m_spriteSlots[slotIndex].denseIndex;
+			}
+			else
+			{
+				slotIndex = static_cast<std::uint32_t>(m_spriteSlots.size());
+				m_spriteSlots.push_back({ SpriteHandle::invalidIndex, 0, 0, 0, 0, 0 });
+			}
+
+			SpriteSlot& slot = m_spriteSlots[slotIndex];
+			slot.denseIndex = static_cast<std::uint32_t>(m_positions.size());
+			slot.sequence = m_nextSpriteSequence++;
+
+			m_positions.emplace_back();
+			m_angles.emplace_back();
+			m_layers.push_back(0);
+			m_spriteDataIndices.push_back(spriteData);
+			m_denseToSlot.push_back(slotIndex);
+			AddSpriteDataRef(spriteData);
+
+			InsertIntoGrid(slotIndex);
+			return { slotIndex, slot.generation };
+		}
+
+		void DestroySprite(SpriteHandle handle)
+		{
+			if(!IsAlive(handle))
+				return;
+
+			RemoveFromGrid(handle.index);
+
+			SpriteSlot& slot = m_spriteSlots[handle.index];
+			const std::uint32_t denseIndex = slot.denseIndex;
+			const std::uint32_t lastIndex = static_cast<std::uint32_t>(m_positions.size() - 1);
+			ReleaseSpriteData(m_spriteDataIndices[denseIndex]);
+
+			if(denseIndex != lastIndex)
+			{
+				m_positions[denseIndex] = m_positions[lastIndex];
+				m_angles[denseIndex] = m_angles[lastIndex];
+				m_layers[denseIndex] = m_layers[lastIndex];
+				m_spriteDataIndices[denseIndex] = m_spriteDataIndices[lastIndex];
+				m_denseToSlot[denseIndex] = m_denseToSlot[lastIndex];
+				m_spriteSlots[m_denseToSlot[denseIndex]].denseIndex = denseIndex;
+			}
+
+			m_positions.pop_back();
+			m_angles.pop_back();
+			m_layers.pop_back();
+			m_spriteDataIndices.pop_back();
+			m_denseToSlot.pop_back();
+
+			slot.generation++;
+			slot.denseIndex = m_freeSpriteSlot;
+			m_freeSpriteSlot = handle.index;
+		}
+
+		bool IsAlive(SpriteHandle handle) const noexcept
+		{
+			return handle.index < m_spriteSlots.size() && m_spriteSlots[handle.index].generation == handle.generation;
+		}
+
+		xk::Math::Aliases::Vector2 GetPosition(SpriteHandle handle) const { return m_positions[DenseIndex(handle)]; }
+		void SetPosition(SpriteHandle handle, xk::Math::Aliases::Vector2 position)
+		{
+			m_positions[DenseIndex(handle)] = position;
+			UpdateGrid(handle.index);
+		}
+
+		xk::Math::Degree<float> GetAngle(SpriteHandle handle) const { return m_angles[DenseIndex(handle)]; }
+		void SetAngle(SpriteHandle handle, xk::Math::Degree<float> angle) { m_angles[DenseIndex(handle)] = angle; }
+
+		//Sprites are drawn in ascending layer order, sprites sharing a layer are batched by texture
+		std::int32_t GetLayer(SpriteHandle handle) const { return m_layers[DenseIndex(handle)]; }
+		void SetLayer(SpriteHandle handle, std::int32_t layer) { m_layers[DenseIndex(handle)] = layer; }
+
+		SpriteDataIndex GetSpriteDataIndex(SpriteHandle handle) const { return m_spriteDataIndices[DenseIndex(handle)]; }
+		void SetSpriteData(SpriteHandle handle, SpriteDataIndex spriteData)
+		{
+			if(!IsSpriteDataAlive(spriteData))
+				throw std::out_of_range("Sprite data index out of range");
+
+			const std::uint32_t denseIndex = DenseIndex(handle);
+			AddSpriteDataRef(spriteData);
+			ReleaseSpriteData(std::exchange(m_spriteDataIndices[denseIndex], spriteData));
+			UpdateGrid(handle.index);
 		}
 
 		DebugRenderer GetDebugRenderer()
@@ -124,27 +364,388 @@ namespace DeluEngine
 			return { backend.get() };
 		}
 
-		std::span<Sprite*> GetSprites() { return m_sprites; }
+		SpriteSpan GetSprites() const noexcept { return { m_positions, m_angles, m_layers, m_spriteDataIndices }; }
+
+		//Invokes func for every sprite whose bounds may overlap region
+		//region is in world space, x and y being the bottom left corner with y pointing up
+		template<std::invocable<SpriteHandle> Func>
+		void QueryRegion(SDL2pp::FRect region, Func&& func) const
+		{
+			ForEachSlotInRegion(region, [&](std::uint32_t slotIndex)
+				{
+					func(SpriteHandle{ slotIndex, m_spriteSlots[slotIndex].generation });
+				});
+		}
+
+		std::vector<SpriteHandle> QueryRegion(SDL2pp::FRect region) const
+		{
+			std::vector<SpriteHandle> sprites;
+			QueryRegion(region, [&](SpriteHandle sprite) { sprites.push_back(sprite); });
+			return sprites;
+		}
+
+		//Sorts the sprites visible in the output by (layer, texture, blend mode) and submits each run as a single geometry batch
+		void DrawSprites();
+
+	private:
+		bool IsSheetRectValid(const SpriteData& data) const noexcept
+		{
+			if(data.sheet == emptySpriteSheet)
+				return true;
+			return data.sheet < m_spriteSheets.size() && m_spriteSheetRefs[data.sheet] > 0 && data.rect < m_spriteSheets[data.sheet].rects.size();
+		}
+
+		bool IsSpriteDataAlive(SpriteDataIndex index) const noexcept
+		{
+			return index < m_spriteData.size() && (index == defaultSpriteData || m_spriteDataRefs[index] > 0);
+		}
+
+		void AddSheetRef(SpriteSheetIndex index) noexcept
+		{
+			if(index != emptySpriteSheet)
+				m_spriteSheetRefs[index]++;
+		}
+
+		void AddSpriteDataRef(SpriteDataIndex index) noexcept
+		{
+			if(index != defaultSpriteData)
+				m_spriteDataRefs[index]++;
+		}
+
+		//Released entries go on a free list for the next Add to reuse
+		void ReleaseSheet(SpriteSheetIndex index)
+		{
+			if(index == emptySpriteSheet || --m_spriteSheetRefs[index] > 0)
+				return;
+
+			m_spriteSheets[index] = {};
+			m_freeSpriteSheets.push_back(index);
+		}
+
+		void ReleaseSpriteData(SpriteDataIndex index)
+		{
+			if(index == defaultSpriteData || --m_spriteDataRefs[index] > 0)
+				return;
+
+			ReleaseSheet(std::exchange(m_spriteData[index], {}).sheet);
+			m_freeSpriteData.push_back(index);
+		}
+
+		static std::int32_t CellCoordinate(float value) noexcept
+		{
+			return static_cast<std::int32_t>(std::floor(value / spatialCellSize));
+		}
+
+		static std::uint64_t CellKey(std::int32_t x, std::int32_t y) noexcept
+		{
+			return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) | static_cast<std::uint32_t>(y);
+		}
+
+		SpriteBounds GetBounds(std::uint32_t denseIndex) const noexcept
+		{
+			const SpriteData& data = m_spriteData[m_spriteDataIndices[denseIndex]];
+			const SpriteSheet& sheet = m_spriteSheets[data.sheet];
+			const SDL2pp::Rect rect = data.rect < sheet.rects.size() ? sheet.rects[data.rect] : SDL2pp::Rect{};
+			const xk::Math::Aliases::Vector2 position = m_positions[denseIndex];
+
+			//Positions are the top left corner of the sprite and the radius covers any rotation around the center
+			return
+			{
+				{ position.X() + rect.w * 0.5f, position.Y() - rect.h * 0.5f },
+				std::sqrt(static_cast<float>(rect.w * rect.w + rect.h * rect.h)) * 0.5f
+			};
+		}
+
+		void InsertIntoGrid(std::uint32_t slotIndex)
+		{
+			SpriteSlot& slot = m_spriteSlots[slotIndex];
+			const SpriteBounds bounds = GetBounds(slot.denseIndex);
+			slot.radius = bounds.radius;
+			m_radiusCounts[slot.radius]++;
+
+			slot.cell = CellKey(CellCoordinate(bounds.center.X()), CellCoordinate(bounds.center.Y()));
+			std::vector<std::uint32_t>& bucket = m_spatialGrid[slot.cell];
+			slot.cellIndex = static_cast<std::uint32_t>(bucket.size());
+			bucket.push_back(slotIndex);
+		}
+
+		void RemoveFromGrid(std::uint32_t slotIndex)
+		{
+			const SpriteSlot& slot = m_spriteSlots[slotIndex];
+			auto bucket = m_spatialGrid.find(slot.cell);
+			const std::uint32_t movedSlot = bucket->second.back();
+			bucket->second[slot.cellIndex] = movedSlot;
+			m_spriteSlots[movedSlot].cellIndex = slot.cellIndex;
+			bucket->second.pop_back();
+			if(bucket->second.empty())
+				m_spatialGrid.erase(bucket);
+
+			auto radius = m_radiusCounts.find(slot.radius);
+			if(--radius->second == 0)
+				m_radiusCounts.erase(radius);
+		}
+
+		float GetMaxSpriteRadius() const noexcept
+		{
+			return m_radiusCounts.empty() ? 0.f : m_radiusCounts.rbegin()->first;
+		}
+
+		void UpdateGrid(std::uint32_t slotIndex)
+		{
+			const SpriteSlot& slot = m_spriteSlots[slotIndex];
+			const SpriteBounds bounds = GetBounds(slot.denseIndex);
+			if(slot.radius == bounds.radius && slot.cell == CellKey(CellCoordinate(bounds.center.X()), CellCoordinate(bounds.center.Y())))
+				return;
+
+			RemoveFromGrid(slotIndex);
+			InsertIntoGrid(slotIndex);
+		}
+
+		template<std::invocable<std::uint32_t> Func>
+		void ForEachSlotInRegion(SDL2pp::FRect region, Func&& func) const
+		{
+			const float regionRight = region.x + region.w;
+			const float regionTop = region.y + region.h;
+			auto overlapsRegion = [&](std::uint32_t slotIndex)
+				{
+					const SpriteBounds bounds = GetBounds(m_spriteSlots[slotIndex].denseIndex);
+					return bounds.center.X() + bounds.radius >= region.x && bounds.center.X() - bounds.radius <= regionRight
+						&& bounds.center.Y() + bounds.radius >= region.y && bounds.center.Y() - bounds.radius <= regionTop;
+				};
+
+			const float padding = GetMaxSpriteRadius();
+			const std::int64_t minX = CellCoordinate(region.x - padding);
+			const std::int64_t minY = CellCoordinate(region.y - padding);
+			const std::int64_t maxX = CellCoordinate(regionRight + padding);
+			const std::int64_t maxY = CellCoordinate(regionTop + padding);
+
+			//Huge regions touch more cells than exist, walking the occupied buckets is cheaper then
+			if(static_cast<std::uint64_t>((maxX - minX + 1) * (maxY - minY + 1)) > m_spatialGrid.size())
+			{
+				for(const auto& [cell, bucket] : m_spatialGrid)
+				{
+					for(std::uint32_t slotIndex : bucket)
+					{
+						if(overlapsRegion(slotIndex))
+							func(slotIndex);
+					}
+				}
+				return;
+			}
+
+			for(std::int64_t y = minY; y <= maxY; y++)
+			{
+				for(std::int64_t x = minX; x <= maxX; x++)
+				{
+					auto it = m_spatialGrid.find(CellKey(static_cast<std::int32_t>(x), static_cast<std::int32_t>(y)));
+					if(it == m_spatialGrid.end())
+						continue;
+
+					for(std::uint32_t slotIndex : it->second)
+					{
+						if(overlapsRegion(slotIndex))
+							func(slotIndex);
+					}
+				}
+			}
+		}
+
+		std::uint32_t DenseIndex(SpriteHandle handle) const
+		{
+			if(!IsAlive(handle))
+				throw std::logic_error("Accessing a destroyed sprite");
+			return m_spriteSlots[handle.index].denseIndex;
+		}
 
+		void SubmitSpriteBatch(std::span<const SpriteSortKey> batch, xk::Math::Aliases::iVector2 outputSize);
+	};
+
+	//Owning wrapper that destroys its sprite when it falls out of scope
+	export class UniqueSprite
+	{
 	private:
-		
-		void DeleteSprite(Sprite* sprite)
+		Renderer* m_renderer = nullptr;
+		SpriteHandle m_handle;
+
+	public:
+		UniqueSprite() noexcept = default;
+		UniqueSprite(Renderer& renderer, SpriteHandle handle) noexcept :
+			m_renderer{ &renderer },
+			m_handle{ handle }
+		{
+
+		}
+
+		UniqueSprite(const UniqueSprite&) = delete;
+		UniqueSprite(UniqueSprite&& other) noexcept :
+			m_renderer{ std::exchange(other.m_renderer, nullptr) },
+			m_handle{ std::exchange(other.m_handle, {}) }
 		{
-			std::erase(m_sprites, sprite);
-			delete sprite;
+
 		}
+
+		~UniqueSprite()
+		{
+			Reset();
+		}
+
+		UniqueSprite& operator=(const UniqueSprite&) = delete;
+		UniqueSprite& operator=(UniqueSprite&& other) noexcept
+		{
+			if(this != &other)
+			{
+				Reset();
+				m_renderer = std::exchange(other.m_renderer, nullptr);
+				m_handle = std::exchange(other.m_handle, {});
+			}
+			return *this;
+		}
+
+	public:
+		SpriteHandle Get() const noexcept { return m_handle; }
+
+		SpriteHandle Release() noexcept
+		{
+			m_renderer = nullptr;
+			return std::exchange(m_handle, {});
+		}
+
+		void Reset() noexcept
+		{
+			if(m_renderer)
+				m_renderer->DestroySprite(std::exchange(m_handle, {}));
+			m_renderer = nullptr;
+		}
+
+		explicit operator bool() const noexcept { return m_renderer && m_renderer->IsAlive(m_handle); }
 	};
 
-	export using SpriteHandle = Renderer::SpriteHandle;
+	//Must not outlive the renderer it came from
+	export template<class Ty>
+	class RendererRef
+	{
+		friend class Renderer;
+
+	private:
+		Renderer* m_renderer = nullptr;
+		std::uint32_t m_index = 0;
+
+		//Adopts a reference the renderer has already counted
+		RendererRef(Renderer& renderer, std::uint32_t index) noexcept :
+			m_renderer{ &renderer },
+			m_index{ index }
+		{
 
-	export std::vector<std::shared_ptr<SpriteData>> LoadSprites(std::string_view filePath, Renderer& renderer)
+		}
+
+	public:
+		RendererRef() noexcept = default;
+		RendererRef(const RendererRef& other) noexcept :
+			m_renderer{ other.m_renderer },
+			m_index{ other.m_index }
+		{
+			if(!m_renderer)
+				return;
+
+			if constexpr(std::same_as<Ty, SpriteSheet>)
+				m_renderer->AddSheetRef(m_index);
+			else
+				m_renderer->AddSpriteDataRef(m_index);
+		}
+
+		RendererRef(RendererRef&& other) noexcept :
+			m_renderer{ std::exchange(other.m_renderer, nullptr) },
+			m_index{ std::exchange(other.m_index, 0) }
+		{
+
+		}
+
+		~RendererRef()
+		{
+			Reset();
+		}
+
+		RendererRef& operator=(RendererRef other) noexcept
+		{
+			std::swap(m_renderer, other.m_renderer);
+			std::swap(m_index, other.m_index);
+			return *this;
+		}
+
+	public:
+		std::uint32_t Get() const noexcept { return m_index; }
+
+		void Reset() noexcept
+		{
+			if(!m_renderer)
+				return;
+
+			if constexpr(std::same_as<Ty, SpriteSheet>)
+				m_renderer->ReleaseSheet(m_index);
+			else
+				m_renderer->ReleaseSpriteData(m_index);
+			m_renderer = nullptr;
+			m_index = 0;
+		}
+
+		explicit operator bool() const noexcept { return m_renderer != nullptr; }
+	};
+
+	SpriteSheetRef Renderer::AddSpriteSheet(SpriteSheet sheet)
+	{
+		SpriteSheetIndex index;
+		if(!m_freeSpriteSheets.empty())
+		{
+			index = m_freeSpriteSheets.back();
+			m_freeSpriteSheets.pop_back();
+			m_spriteSheets[index] = std::move(sheet);
+		}
+		else
+		{
+			index = static_cast<SpriteSheetIndex>(m_spriteSheets.size());
+			m_spriteSheets.push_back(std::move(sheet));
+			m_spriteSheetRefs.push_back(0);
+		}
+
+		m_spriteSheetRefs[index] = 1;
+		return { *this, index };
+	}
+
+	SpriteDataRef Renderer::AddSpriteData(SpriteData data)
 	{
-		std::vector<std::shared_ptr<SpriteData>> sprites;
+		if(!IsSheetRectValid(data))
+			throw std::out_of_range("Sprite data does not reference a valid sprite sheet rect");
+
+		AddSheetRef(data.sheet);
 
+		SpriteDataIndex index;
+		if(!m_freeSpriteData.empty())
+		{
+			index = m_freeSpriteData.back();
+			m_freeSpriteData.pop_back();
+			m_spriteData[index] = std::move(data);
+		}
+		else
+		{
+			index = static_cast<SpriteDataIndex>(m_spriteData.size());
+			m_spriteData.push_back(std::move(data));
+			m_spriteDataRefs.push_back(0);
+		}
+
+		m_spriteDataRefs[index] = 1;
+		return { *this, index };
+	}
+
+	//The sheet lives until the returned refs and every sprite created from them are gone
+	export std::vector<SpriteDataRef> LoadSprites(std::string_view filePath, Renderer& renderer)
+	{
+		XK_PROFILE_ZONE("LoadSprites");
 		std::ifstream file{ std::string{ filePath } };
 		nlohmann::json json = nlohmann::json::parse(file);
 		std::string imageFilePath = json["filePath"];
 		SDL2pp::unique_ptr<SDL2pp::Surface> surface{ IMG_Load(imageFilePath.data()) };
+
+		SpriteSheet sheet{ renderer.backend->CreateTexture(surface.get()) };
 		for (auto& spritesData : json["sprites"])
 		{
 			auto rectArray = spritesData["rect"];
@@ -161,14 +762,134 @@ namespace DeluEngine
 				.h = yMax - yMin
 			};
 
-			sprites.push_back(std::make_shared<SpriteData>(renderer.backend->CreateTexture(surface.get()), rect));
+			sheet.rects.push_back(rect);
+		}
+
+		const std::uint32_t rectCount = static_cast<std::uint32_t>(sheet.rects.size());
+		const SpriteSheetRef sheetRef = renderer.AddSpriteSheet(std::move(sheet));
+
+		std::vector<SpriteDataRef> sprites;
+		sprites.reserve(rectCount);
+		for(std::uint32_t i = 0; i < rectCount; i++)
+		{
+			sprites.push_back(renderer.AddSpriteData({ .sheet = sheetRef.Get(), .rect = i }));
 		}
 
 		return sprites;
 	}
 
-	void Sprite::SetSpriteData(std::shared_ptr<SpriteData> data)
+	void Renderer::DrawSprites()
 	{
-		m_data = data ? std::move(data) : m_owningRenderer->defaultSpriteData;
+		XK_PROFILE_ZONE("Renderer::DrawSprites");
+		const xk::Math::Aliases::iVector2 outputSize = backend->GetOutputSize();
+
+		m_sortKeys.clear();
+		ForEachSlotInRegion(SDL2pp::FRect{ 0, 0, static_cast<float>(outputSize.X()), static_cast<float>(outputSize.Y()) }, [this](std::uint32_t slotIndex)
+			{
+				const std::uint32_t denseIndex = m_spriteSlots[slotIndex].denseIndex;
+				const SpriteData& data = m_spriteData[m_spriteDataIndices[denseIndex]];
+				SDL2pp::Texture* texture = m_spriteSheets[data.sheet].texture.get();
+				if(!texture)
+					return;
+
+				m_sortKeys.push_back({ m_layers[denseIndex], texture, data.blendMode, m_spriteSlots[slotIndex].sequence, denseIndex });
+			});
+
+		auto batchOrder = [](const SpriteSortKey& lh, const SpriteSortKey& rh)
+			{
+				if(lh.layer != rh.layer)
+					return lh.layer < rh.layer;
+				if(lh.texture != rh.texture)
+					return std::less<SDL2pp::Texture*>{}(lh.texture, rh.texture);
+				return lh.blendMode < rh.blendMode;
+			};
+
+		//The grid visits sprites in cell order, ties are drawn in creation order so overlaps don't flip between frames
+		std::sort(m_sortKeys.begin(), m_sortKeys.end(), [&](const SpriteSortKey& lh, const SpriteSortKey& rh)
+			{
+				if(batchOrder(lh, rh))
+					return true;
+				if(batchOrder(rh, lh))
+					return false;
+				return lh.sequence < rh.sequence;
+			});
+
+		for(auto batchBegin = m_sortKeys.begin(); batchBegin != m_sortKeys.end();)
+		{
+			auto batchEnd = std::find_if(batchBegin, m_sortKeys.end(), [&](const SpriteSortKey& key) { return batchOrder(*batchBegin, key); });
+			SubmitSpriteBatch({ batchBegin, batchEnd }, outputSize);
+			batchBegin = batchEnd;
+		}
+	}
+
+	void Renderer::SubmitSpriteBatch(std::span<const SpriteSortKey> batch, xk::Math::Aliases::iVector2 outputSize)
+	{
+		SDL2pp::view_ptr<SDL2pp::Texture> texture = batch.front().texture;
+		const xk::Math::Aliases::Vector2 textureSize = texture->GetSize();
+		texture->SetBlendMode(batch.front().blendMode);
+
+		m_batchVertices.clear();
+		m_batchIndices.clear();
+		m_batchVertices.reserve(batch.size() * 4);
+		m_batchIndices.reserve(batch.size() * 6);
+
+		for(const SpriteSortKey& key : batch)
+		{
+			const SpriteData& data = m_spriteData[m_spriteDataIndices[key.denseIndex]];
+			const SDL2pp::Rect sourceRect = m_spriteSheets[data.sheet].rects[data.rect];
+			const xk::Math::Aliases::Vector2 position = m_positions[key.denseIndex];
+			const float halfWidth = sourceRect.w * 0.5f;
+			const float halfHeight = sourceRect.h * 0.5f;
+
+			//Matches CopyEx, which rotates clockwise around the center of the destination rect
+			const SDL2pp::FPoint center
+			{
+				position.X() + halfWidth,
+				-position.Y() + outputSize.Y() + halfHeight
+			};
+			const float radians = m_angles[key.denseIndex]._value * std::numbers::pi_v<float> / 180.f;
+			const float cosAngle = std::cos(radians);
+			const float sinAngle = std::sin(radians);
+
+			const float uMin = sourceRect.x / textureSize.X();
+			const float vMin = sourceRect.y / textureSize.Y();
+			const float uMax = (sourceRect.x + sourceRect.w) / textureSize.X();
+			const float vMax = (sourceRect.y + sourceRect.h) / textureSize.Y();
+
+			const std::array<SDL2pp::FPoint, 4> corners
+			{
+				SDL2pp::FPoint{ -halfWidth, -halfHeight },
+				SDL2pp::FPoint{ halfWidth, -halfHeight },
+				SDL2pp::FPoint{ halfWidth, halfHeight },
+				SDL2pp::FPoint{ -halfWidth, halfHeight },
+			};
+			const std::array<SDL2pp::FPoint, 4> uvs
+			{
+				SDL2pp::FPoint{ uMin, vMin },
+				SDL2pp::FPoint{ uMax, vMin },
+				SDL2pp::FPoint{ uMax, vMax },
+				SDL2pp::FPoint{ uMin, vMax },
+			};
+
+			const int baseIndex = static_cast<int>(m_batchVertices.size());
+			for(std::size_t i = 0; i < corners.size(); i++)
+			{
+				m_batchVertices.push_back(SDL2pp::Vertex
+					{
+						.position{ center.x + corners[i].x * cosAngle - corners[i].y * sinAngle, center.y + corners[i].x * sinAngle + corners[i].y * cosAngle },
+						.color{ 255, 255, 255, 255 },
+						.tex_coord{ uvs[i] }
+					});
+			}
+
+			for(int index : { 0, 1, 2, 2, 3, 0 })
+			{
+				m_batchIndices.push_back(baseIndex + index);
+			}
+		}
+
+		backend->DrawGeometry(texture, m_batchVertices, m_batchIndices);
+		stats.drawCalls++;
+		stats.spritesDrawn += batch.size();
 	}
 };
\ No newline at end of file
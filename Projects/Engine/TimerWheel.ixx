@@ -0,0 +1,329 @@
+module;
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+export module DeluEngine:TimerWheel;
+
+namespace DeluEngine
+{
+	//Identifies a scheduled timer, stays safe to cancel after the timer has fired or been reused
+	export struct TimerHandle
+	{
+		std::uint32_t index = std::numeric_limits<std::uint32_t>::max();
+		std::uint32_t generation = 0;
+	};
+
+	//Hierarchical timer wheel ticking in whole milliseconds of the time it is advanced by
+	//Scheduling and cancelling are O(1), pending timers are only touched when their slot comes up or cascades down a level
+	export class TimerWheel
+	{
+	public:
+		using Callback = std::function<void()>;
+		static constexpr std::chrono::nanoseconds tickLength = std::chrono::milliseconds{ 1 };
+
+	private:
+		static constexpr std::uint32_t slotBits = 8;
+		static constexpr std::uint32_t slotCount = 1 << slotBits;
+		static constexpr std::uint32_t slotMask = slotCount - 1;
+		static constexpr std::uint32_t levelCount = 4;
+
+		static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+		//Timers whose slot has come up, kept as a list so callbacks can still cancel the ones yet to run
+		static constexpr std::uint32_t firingList = levelCount * slotCount;
+
+		struct Timer
+		{
+			Callback callback;
+			std::uint64_t expiry = 0;
+			std::uint64_t period = 0;
+			std::uint32_t previous = none;
+			std::uint32_t next = none;
+			std::uint32_t list = none;
+			std::uint32_t generation = 0;
+			bool live = false;
+		};
+
+		//Free timers are chained through next
+		std::vector<Timer> m_timers;
+		std::uint32_t m_freeTimer = none;
+		std::size_t m_liveTimers = 0;
+
+		std::array<std::uint32_t, levelCount * slotCount + 1> m_lists;
+		std::uint64_t m_currentTick = 0;
+		std::chrono::nanoseconds m_untickedTime{ 0 };
+
+	public:
+		TimerWheel()
+		{
+			m_lists.fill(none);
+		}
+
+		TimerWheel(const TimerWheel&) = delete;
+		TimerWheel& operator=(const TimerWheel&) = delete;
+
+		//Fires once delay has passed, rounded up to the next tick
+		TimerHandle ScheduleOnce(std::chrono::nanoseconds delay, Callback callback)
+		{
+			return Schedule(ToTicks(delay), 0, std::move(callback));
+		}
+
+		//Fires every period, the first time one period from now
+		//Periods are kept from the intended expiry, so late ticks don't make the timer drift
+		TimerHandle ScheduleRepeating(std::chrono::nanoseconds period, Callback callback)
+		{
+			const std::uint64_t ticks = ToTicks(period);
+			return Schedule(ticks, ticks, std::move(callback));
+		}
+
+		//Returns false if the timer already fired for the last time or was cancelled
+		bool Cancel(TimerHandle handle)
+		{
+			if(!IsScheduled(handle))
+				return false;
+
+			Unlink(handle.index);
+			Free(handle.index);
+			return true;
+		}
+
+		bool IsScheduled(TimerHandle handle) const noexcept
+		{
+			return handle.index < m_timers.size() && m_timers[handle.index].live && m_timers[handle.index].generation == handle.generation;
+		}
+
+		std::size_t GetScheduledCount() const noexcept { return m_liveTimers; }
+
+		//Fires every timer that expires within deltaTime
+		//Callbacks may schedule and cancel timers, including their own
+		void Advance(std::chrono::nanoseconds deltaTime)
+		{
+			m_untickedTime += deltaTime;
+			const auto ticks = static_cast<std::uint64_t>(m_untickedTime / tickLength);
+			m_untickedTime -= ticks * tickLength;
+
+			const std::uint64_t targetTick = m_currentTick + ticks;
+			while(m_currentTick < targetTick)
+			{
+				//Nothing could expire on the way, skip straight to the end
+				if(m_liveTimers == 0)
+				{
+					m_currentTick = targetTick;
+					return;
+				}
+
+				m_currentTick++;
+				Cascade();
+				Fire(m_currentTick & slotMask);
+			}
+		}
+
+	private:
+		static std::uint64_t ToTicks(std::chrono::nanoseconds duration)
+		{
+			const auto ticks = (duration + tickLength - std::chrono::nanoseconds{ 1 }) / tickLength;
+			return ticks > 0 ? static_cast<std::uint64_t>(ticks) : 1;
+		}
+
+		TimerHandle Schedule(std::uint64_t delay, std::uint64_t period, Callback callback)
+		{
+			std::uint32_t index = m_freeTimer;
+			if(index != none)
+			{
+				m_freeTimer = m_timers[index].next;
+			}
+			else
+			{
+				index = static_cast<std::uint32_t>(m_timers.size());
+				m_timers.emplace_back();
+			}
+
+			Timer& timer = m_timers[index];
+			timer.callback = std::move(callback);
+			timer.expiry = m_currentTick + delay;
+			timer.period = period;
+			timer.live = true;
+			m_liveTimers++;
+			Link(index);
+			return { index, timer.generation };
+		}
+
+		void Free(std::uint32_t index)
+		{
+			Timer& timer = m_timers[index];
+			timer.callback = nullptr;
+			timer.live = false;
+			timer.generation++;
+			timer.next = m_freeTimer;
+			m_freeTimer = index;
+			m_liveTimers--;
+		}
+
+		//Picks the lowest level whose slots still reach the expiry
+		//Slots are compared at each level's granularity so a timer never lands in the slot that level is currently on
+		void Link(std::uint32_t index)
+		{
+			Timer& timer = m_timers[index];
+			std::uint32_t list = none;
+			for(std::uint32_t level = 0; level < levelCount; level++)
+			{
+				const std::uint32_t shift = level * slotBits;
+				if((timer.expiry >> shift) - (m_currentTick >> shift) < slotCount)
+				{
+					list = level * slotCount + static_cast<std::uint32_t>((timer.expiry >> shift) & slotMask);
+					break;
+				}
+			}
+
+			//Further out than the wheel reaches, park it in the last slot of the top level to be relinked when that cascades
+			if(list == none)
+			{
+				const std::uint32_t shift = (levelCount - 1) * slotBits;
+				list = (levelCount - 1) * slotCount + static_cast<std::uint32_t>(((m_currentTick >> shift) + slotMask) & slotMask);
+			}
+
+			PushFront(index, list);
+		}
+
+		void PushFront(std::uint32_t index, std::uint32_t list)
+		{
+			Timer& timer = m_timers[index];
+			timer.list = list;
+			timer.previous = none;
+			timer.next = m_lists[list];
+			if(timer.next != none)
+				m_timers[timer.next].previous = index;
+			m_lists[list] = index;
+		}
+
+		void Unlink(std::uint32_t index)
+		{
+			Timer& timer = m_timers[index];
+			if(timer.list == none)
+				return;
+
+			if(timer.previous != none)
+				m_timers[timer.previous].next = timer.next;
+			else
+				m_lists[timer.list] = timer.next;
+
+			if(timer.next != none)
+				m_timers[timer.next].previous = timer.previous;
+
+			timer.list = timer.previous = timer.next = none;
+		}
+
+		//Moves the timers of every higher level slot that has just come up into the lower levels
+		void Cascade()
+		{
+			std::uint32_t topLevel = 0;
+			while(topLevel + 1 < levelCount && (m_currentTick & ((std::uint64_t{ 1 } << ((topLevel + 1) * slotBits)) - 1)) == 0)
+			{
+				topLevel++;
+			}
+
+			for(std::uint32_t level = topLevel; level > 0; level--)
+			{
+				const std::uint32_t list = level * slotCount + static_cast<std::uint32_t>((m_currentTick >> (level * slotBits)) & slotMask);
+				std::uint32_t index = std::exchange(m_lists[list], none);
+				while(index != none)
+				{
+					const std::uint32_t next = m_timers[index].next;
+					m_timers[index].list = none;
+					Link(index);
+					index = next;
+				}
+			}
+		}
+
+		void Fire(std::uint32_t slot)
+		{
+			m_lists[firingList] = std::exchange(m_lists[slot], none);
+			for(std::uint32_t index = m_lists[firingList]; index != none; index = m_timers[index].next)
+			{
+				m_timers[index].list = firingList;
+			}
+
+			while(m_lists[firingList] != none)
+			{
+				const std::uint32_t index = m_lists[firingList];
+				Unlink(index);
+
+				//Moved out as callbacks may schedule timers and reallocate m_timers
+				const std::uint32_t generation = m_timers[index].generation;
+				Callback callback = std::move(m_timers[index].callback);
+				callback();
+
+				//Cancelled from its own callback
+				if(!m_timers[index].live || m_timers[index].generation != generation)
+					continue;
+
+				Timer& timer = m_timers[index];
+				if(timer.period == 0)
+				{
+					Free(index);
+					continue;
+				}
+
+				timer.callback = std::move(callback);
+				timer.expiry += timer.period;
+				if(timer.expiry <= m_currentTick)
+					timer.expiry = m_currentTick + 1;
+				Link(index);
+			}
+		}
+	};
+
+	//Owns a scheduled timer and cancels it when destroyed
+	export class UniqueTimer
+	{
+	private:
+		TimerWheel* m_wheel = nullptr;
+		TimerHandle m_handle;
+
+	public:
+		UniqueTimer() = default;
+		UniqueTimer(TimerWheel& wheel, TimerHandle handle) :
+			m_wheel{ &wheel },
+			m_handle{ handle }
+		{
+
+		}
+
+		UniqueTimer(const UniqueTimer&) = delete;
+		UniqueTimer(UniqueTimer&& other) noexcept :
+			m_wheel{ std::exchange(other.m_wheel, nullptr) },
+			m_handle{ other.m_handle }
+		{
+
+		}
+
+		UniqueTimer& operator=(const UniqueTimer&) = delete;
+		UniqueTimer& operator=(UniqueTimer&& other) noexcept
+		{
+			Reset();
+			m_wheel = std::exchange(other.m_wheel, nullptr);
+			m_handle = other.m_handle;
+			return *this;
+		}
+
+		~UniqueTimer()
+		{
+			Reset();
+		}
+
+		void Reset()
+		{
+			if(m_wheel)
+				std::exchange(m_wheel, nullptr)->Cancel(m_handle);
+		}
+
+		bool IsScheduled() const noexcept { return m_wheel && m_wheel->IsScheduled(m_handle); }
+	};
+}
@@ -8,10 +8,13 @@ module;
 #include <SDL2/SDL_image.h>
 #include <iostream>
 #include <array>
+#include <string>
 #include <span>
 #include <cstdlib>
 #include <ctime>
 #include <format>
+#include <algorithm>
+#include <random>
 #include <SDL2/SDL_mixer.h>
 
 export module DeluGame;
@@ -23,17 +26,31 @@ std::array<Mix_Chunk*, 3> correctEffects;
 std::array<Mix_Chunk*, 4> missEffects;
 Mix_Music* bgm;
 using SDL2pp::SDL2Interface;
+//Lays the button out at its image's size once the image has loaded
+DeluEngine::AsyncTexture LoadButtonImage(DeluEngine::Engine& engine, DeluEngine::GUI::Button& button, std::string path)
+{
+	return engine.assets.LoadTexture(std::move(path), DeluEngine::AssetResidency::Persistent, [&button](const DeluEngine::AsyncTexture& texture)
+		{
+			button.SetLocalSize(DeluEngine::GUI::AbsoluteSize{ { texture.GetSize().X(), texture.GetSize().Y() } });
+			button.ConvertUnderlyingSizeRepresentation<DeluEngine::GUI::AspectRatioRelativeSize>();
+			button.SetTexture(texture.Get());
+		});
+}
+
 export struct Card
 {
 	DeluEngine::GUI::UniqueHandle<DeluEngine::GUI::Button> backCardButton;
 	DeluEngine::GUI::UniqueHandle<DeluEngine::GUI::Image> frontCard;
 	DeluEngine::GUI::UniqueHandle<DeluEngine::GUI::Image> cardTypeIcon;
+	std::size_t type;
 
-	Card(DeluEngine::GUI::GUIEngine& frame, DeluEngine::GUI::SizeVariant size, SDL2pp::shared_ptr<SDL2pp::Texture> backTexture, SDL2pp::shared_ptr<SDL2pp::Texture> frontTexture, SDL2pp::shared_ptr<SDL2pp::Texture> cardTypeTexture)
+	//Textures are filled in by the grid as they finish loading
+	Card(DeluEngine::GUI::GUIEngine& frame, DeluEngine::GUI::SizeVariant size, std::size_t type) :
+		type{ type }
 	{
-		backCardButton = frame.NewElement<DeluEngine::GUI::Button>(DeluEngine::GUI::RelativePosition{}, size, xk::Math::Aliases::Vector2{ 0.5f, 0.5f }, nullptr, backTexture);
-		frontCard = frame.NewElement<DeluEngine::GUI::Image>(DeluEngine::GUI::RelativePosition{}, size, xk::Math::Aliases::Vector2{ 0.5f, 0.5f }, nullptr, frontTexture);
-		cardTypeIcon = frame.NewElement<DeluEngine::GUI::Image>(DeluEngine::GUI::RelativePosition{ { 0.5f, 0.5f} }, DeluEngine::GUI::BorderConstantRelativeSize{ .value = { 0.8f, 0.8f } }, xk::Math::Aliases::Vector2{ 0.5f, 0.5f }, frontCard.get(), cardTypeTexture);
+		backCardButton = frame.NewElement<DeluEngine::GUI::Button>(DeluEngine::GUI::RelativePosition{}, size, xk::Math::Aliases::Vector2{ 0.5f, 0.5f }, nullptr);
+		frontCard = frame.NewElement<DeluEngine::GUI::Image>(DeluEngine::GUI::RelativePosition{}, size, xk::Math::Aliases::Vector2{ 0.5f, 0.5f }, nullptr);
+		cardTypeIcon = frame.NewElement<DeluEngine::GUI::Image>(DeluEngine::GUI::RelativePosition{ { 0.5f, 0.5f} }, DeluEngine::GUI::BorderConstantRelativeSize{ .value = { 0.8f, 0.8f } }, xk::Math::Aliases::Vector2{ 0.5f, 0.5f }, frontCard.get());
 		FlipDown();
 	}
 
@@ -45,20 +62,20 @@ export struct Card
 
 	void FlipUp()
 	{
-		backCardButton->render = false;
-		backCardButton->debugEnableRaytrace = false;
+		backCardButton->SetRender(false);
+		backCardButton->SetRaytrace(false);
 
-		frontCard->render = true;
-		cardTypeIcon->render = true;
+		frontCard->SetRender(true);
+		cardTypeIcon->SetRender(true);
 	}
 
 	void FlipDown()
 	{
-		backCardButton->render = true;
-		backCardButton->debugEnableRaytrace = true;
+		backCardButton->SetRender(true);
+		backCardButton->SetRaytrace(true);
 
-		frontCard->render = false;
-		cardTypeIcon->render = false;
+		frontCard->SetRender(false);
+		cardTypeIcon->SetRender(false);
 	}
 
 	void SetLocalPosition(DeluEngine::GUI::PositionVariant position)
@@ -67,11 +84,31 @@ export struct Card
 		frontCard->SetLocalPosition(position);
 	}
 
-	auto GetType() const { return cardTypeIcon->texture; }
+	std::size_t GetType() const { return type; }
 
 	std::function<void()>& OnClicked() { return backCardButton->onClicked; }
 };
 
+//Which card goes where and the textures they need, decided before any of the scene's GUI exists
+export struct CardMatchLayout
+{
+	xk::Math::Aliases::iVector2 cardCount;
+
+	//Card type of each grid slot, row by row, an odd slot count gets one spare card past the grid
+	std::vector<std::size_t> slotTypes;
+	std::vector<DeluEngine::AsyncTexture> cardTypeTextures;
+	DeluEngine::AsyncTexture cardFrontTexture;
+	DeluEngine::AsyncTexture cardBackTexture;
+
+	//Every requested texture has either been uploaded or failed
+	bool IsSettled() const
+	{
+		auto settled = [](const DeluEngine::AsyncTexture& texture) { return !texture || texture.IsLoaded() || texture.IsFailed(); };
+		return std::ranges::all_of(cardTypeTextures, settled) && settled(cardFrontTexture) && settled(cardBackTexture);
+	}
+};
+
+//Loads the scene in one go on the calling thread
 export struct CardMatchSceneLoader
 {
 	xk::Math::Aliases::iVector2 cardCount;
@@ -80,32 +117,32 @@ export struct CardMatchSceneLoader
 
 export CardMatchSceneLoader CardMatchScene(xk::Math::Aliases::iVector2 cardCount);
 
+//Lays the grid out and requests its textures on the thread pool, the current scene keeps running until they have loaded
+//Only the GUI is built on the game thread, once the scene is swapped in
+export void StreamCardMatchScene(DeluEngine::Engine& engine, xk::Math::Aliases::iVector2 cardCount);
+
 export struct VictoryScreen
 {
 	DeluEngine::GUI::UniqueHandle<DeluEngine::GUI::Button> retryButton;
 	DeluEngine::GUI::UniqueHandle<DeluEngine::GUI::Button> quitButton;
+	std::array<DeluEngine::AsyncTexture, 2> buttonImages;
 
 	VictoryScreen(DeluEngine::Engine& engine, DeluEngine::GUI::GUIEngine& frame)
 	{
-		SDL_Surface* quitButtonPNG = IMG_Load("Quit_Button.png");
-		SDL_Surface* retryButtonPNG = IMG_Load("PlayAgain_Button.png");
-		quitButton = frame.NewElement<DeluEngine::GUI::Button>(DeluEngine::GUI::RelativePosition{ { 0.40f, 0.33f } }, DeluEngine::GUI::AbsoluteSize{ { quitButtonPNG->w, quitButtonPNG->h } }, xk::Math::Aliases::Vector2{ 0.5f, 0.0f }, nullptr, engine.renderer.backend->CreateTexture(quitButtonPNG));
-		quitButton->ConvertUnderlyingSizeRepresentation<DeluEngine::GUI::AspectRatioRelativeSize>();
-		retryButton = frame.NewElement<DeluEngine::GUI::Button>(DeluEngine::GUI::RelativePosition{ { 0.60f, 0.33f } }, DeluEngine::GUI::AbsoluteSize{ { retryButtonPNG->w, retryButtonPNG->h } }, xk::Math::Aliases::Vector2{ 0.5f, 0.0f }, nullptr, engine.renderer.backend->CreateTexture(retryButtonPNG));
-		retryButton->ConvertUnderlyingSizeRepresentation<DeluEngine::GUI::AspectRatioRelativeSize>();
+		quitButton = frame.NewElement<DeluEngine::GUI::Button>(DeluEngine::GUI::RelativePosition{ { 0.40f, 0.33f } }, DeluEngine::GUI::AbsoluteSize{}, xk::Math::Aliases::Vector2{ 0.5f, 0.0f }, nullptr);
+		retryButton = frame.NewElement<DeluEngine::GUI::Button>(DeluEngine::GUI::RelativePosition{ { 0.60f, 0.33f } }, DeluEngine::GUI::AbsoluteSize{}, xk::Math::Aliases::Vector2{ 0.5f, 0.0f }, nullptr);
+		buttonImages[0] = LoadButtonImage(engine, *quitButton, "Quit_Button.png");
+		buttonImages[1] = LoadButtonImage(engine, *retryButton, "PlayAgain_Button.png");
 
 		retryButton->onClicked = [&engine]
 			{
-				engine.queuedScene = CardMatchScene({ 6, 6 });
+				StreamCardMatchScene(engine, { 6, 6 });
 			};
 
 		quitButton->onClicked = [&engine]
 			{
 				engine.running = false;
 			};
-
-		SDL_FreeSurface(quitButtonPNG);
-		SDL_FreeSurface(retryButtonPNG);
 	}
 };
 
@@ -115,7 +152,11 @@ export struct PauseScreen
 	DeluEngine::GUI::UniqueHandle<DeluEngine::GUI::Button> quitButton;
 	DeluEngine::GUI::UniqueHandle<DeluEngine::GUI::Button> retryButton;
 	DeluEngine::GUI::UniqueHandle<DeluEngine::GUI::Button> resumeButton;
+	std::array<DeluEngine::AsyncTexture, 3> buttonImages;
 	DeluEngine::Engine* e;
+
+	//Restored on close, so pausing doesn't undo a slow motion or another pause already in effect
+	float previousTimeMultiplier;
 	PauseScreen(DeluEngine::Engine& engine, DeluEngine::GUI::GUIEngine& frame)
 	{
 		
@@ -133,37 +174,34 @@ export struct PauseScreen
 
 		engine.controllerContext.PushContext("Pause");
 
-		SDL_Surface* quitButtonPNG = IMG_Load("Quit_Button.png");
-		SDL_Surface* retryButtonPNG = IMG_Load("PlayAgain_Button.png");
-		SDL_Surface* resumeButtonPNG = IMG_Load("Resume_Button.png");
+		//Holds timers such as the card reveal along with everything else in the group
+		DeluEngine::PulseGroup& gameGroup = DeluEngine::gHeart.GetGroup("Game");
+		previousTimeMultiplier = gameGroup.GetTimeMultiplier();
+		gameGroup.SetTimeMultiplier(0);
 
-		quitButton = frame.NewElement<DeluEngine::GUI::Button>(DeluEngine::GUI::RelativePosition{ { 0.3f, 0.33f } }, DeluEngine::GUI::AbsoluteSize{ { quitButtonPNG->w, quitButtonPNG->h } }, xk::Math::Aliases::Vector2{ 0.5f, 0.0f }, nullptr, engine.renderer.backend->CreateTexture(quitButtonPNG));
-		quitButton->ConvertUnderlyingSizeRepresentation<DeluEngine::GUI::AspectRatioRelativeSize>();
-		retryButton = frame.NewElement<DeluEngine::GUI::Button>(DeluEngine::GUI::RelativePosition{ { 0.5f, 0.33f } }, DeluEngine::GUI::AbsoluteSize{ { retryButtonPNG->w, retryButtonPNG->h } }, xk::Math::Aliases::Vector2{ 0.5f, 0.0f }, nullptr, engine.renderer.backend->CreateTexture(retryButtonPNG));
-		retryButton->ConvertUnderlyingSizeRepresentation<DeluEngine::GUI::AspectRatioRelativeSize>();
-		resumeButton = frame.NewElement<DeluEngine::GUI::Button>(DeluEngine::GUI::RelativePosition{ { 0.7f, 0.33f } }, DeluEngine::GUI::AbsoluteSize{ { resumeButtonPNG->w, resumeButtonPNG->h } }, xk::Math::Aliases::Vector2{ 0.5f, 0.0f }, nullptr, engine.renderer.backend->CreateTexture(resumeButtonPNG));
-		resumeButton->ConvertUnderlyingSizeRepresentation<DeluEngine::GUI::AspectRatioRelativeSize>();
+		quitButton = frame.NewElement<DeluEngine::GUI::Button>(DeluEngine::GUI::RelativePosition{ { 0.3f, 0.33f } }, DeluEngine::GUI::AbsoluteSize{}, xk::Math::Aliases::Vector2{ 0.5f, 0.0f }, nullptr);
+		retryButton = frame.NewElement<DeluEngine::GUI::Button>(DeluEngine::GUI::RelativePosition{ { 0.5f, 0.33f } }, DeluEngine::GUI::AbsoluteSize{}, xk::Math::Aliases::Vector2{ 0.5f, 0.0f }, nullptr);
+		resumeButton = frame.NewElement<DeluEngine::GUI::Button>(DeluEngine::GUI::RelativePosition{ { 0.7f, 0.33f } }, DeluEngine::GUI::AbsoluteSize{}, xk::Math::Aliases::Vector2{ 0.5f, 0.0f }, nullptr);
+		buttonImages[0] = LoadButtonImage(engine, *quitButton, "Quit_Button.png");
+		buttonImages[1] = LoadButtonImage(engine, *retryButton, "PlayAgain_Button.png");
+		buttonImages[2] = LoadButtonImage(engine, *resumeButton, "Resume_Button.png");
 
 
 		retryButton->onClicked = [&]
 			{
-				engine.queuedScene = CardMatchScene({ 6, 6 });
+				StreamCardMatchScene(engine, { 6, 6 });
 			};
 
 		quitButton->onClicked = [&]
 			{
 				engine.running = false;
 			};
-
-		SDL_FreeSurface(quitButtonPNG);
-		SDL_FreeSurface(retryButtonPNG);
-		SDL_FreeSurface(resumeButtonPNG);
-
 	}
 
 	~PauseScreen()
 	{
 		e->controllerContext.PopContext();
+		DeluEngine::gHeart.GetGroup("Game").SetTimeMultiplier(previousTimeMultiplier);
 	}
 };
 
@@ -176,31 +214,42 @@ export struct CardGrid : public DeluEngine::SceneSystem, public DeluEngine::Puls
 	std::unique_ptr<VictoryScreen> victoryScreen;
 	std::unique_ptr<PauseScreen> pauseScreen;
 
+	//Kept so the loads stay alive, and to apply to cards as the textures arrive
+	std::vector<DeluEngine::AsyncTexture> cardTypeTextures;
+	DeluEngine::AsyncTexture cardBackTexture;
+	DeluEngine::AsyncTexture cardFrontTexture;
+
 	std::array<Card*, 2> selectedCards{};
 	DeluEngine::Engine* engine;
-	float timer = 0;
+
+	//Turns a selected pair over or removes it once the player has had a moment to see both
+	DeluEngine::UniqueTimer revealTimer;
 	float gameTime = 0;
 	int moveCount = 0;
 	bool pendingClosePauseScreen = false;
 
 public:
-	CardGrid(const gsl::not_null<ECS::Scene*> scene, DeluEngine::GUI::GUIEngine& frame, xk::Math::Aliases::iVector2 gridSize, std::span<SDL2pp::shared_ptr<SDL2pp::Texture>> textures, SDL2pp::shared_ptr<SDL2pp::Texture> cardBack, SDL2pp::shared_ptr<SDL2pp::Texture> cardFront) :
+	CardGrid(const gsl::not_null<ECS::Scene*> scene, DeluEngine::GUI::GUIEngine& frame, CardMatchLayout layout) :
 		SceneSystem{ scene },
-		PulseCallback{ "Game" }
+		PulseCallback{ "Game", "CardGrid" },
+		cardTypeTextures(std::move(layout.cardTypeTextures)),
+		cardBackTexture{ std::move(layout.cardBackTexture) },
+		cardFrontTexture{ std::move(layout.cardFrontTexture) }
 	{
+		const xk::Math::Aliases::iVector2 gridSize = layout.cardCount;
 
 		engine = &GetEngine();
 		engine->controllerContext.PushContext("Game");
 		engine->controllerContext.GetCurrentContext().FindAction("Pause").BindButton([this](bool) { OpenPauseMenu();  });
 
-		TTF_Font* arialFont = TTF_OpenFont("arial.ttf", 20);
+		DeluEngine::Font* arialFont = &engine->fonts.Get("arial.ttf", 20);
 
 		moveCountText = frame.NewElement<DeluEngine::GUI::Text>(DeluEngine::GUI::RelativePosition{ {0.05f, 0.9f} }, DeluEngine::GUI::RelativeSize{ { 0.15f, 0.1f } }, { 0, 1 }, nullptr);
 		gameTimeText = frame.NewElement<DeluEngine::GUI::Text>(DeluEngine::GUI::RelativePosition{ {0.05f, 0.95f} }, DeluEngine::GUI::RelativeSize{ { 0.15f, 0.1f } }, { 0, 1 }, nullptr);
 
 		moveCountText->SetText(std::format("Moves: {}", moveCount));
 		moveCountText->SetFont(arialFont);
-		gameTimeText->SetText(std::format("Time: {}", timer));
+		gameTimeText->SetText(std::format("Time: {}", gameTime));
 		gameTimeText->SetFont(arialFont);
 		auto makeCardsOnClicked = [this](Card* thisCard)
 			{
@@ -223,27 +272,19 @@ public:
 							moveCount++;
 							moveCountText->SetText(std::format("Moves: {}", moveCount));
 							PlayCardPairAudio();
+
+							DeluEngine::TimerWheel& timers = DeluEngine::gHeart.GetGroup("Game").GetTimers();
+							revealTimer = { timers, timers.ScheduleOnce(std::chrono::seconds{ 1 }, [this] { CheckMatchingCards(); }) };
 						}
 					};
 			};
 		
 		gridAligningParent = frame.NewElement<DeluEngine::GUI::UIElement>(DeluEngine::GUI::RelativePosition{ { 0.5f, 0.5f } }, DeluEngine::GUI::AspectRatioRelativeSize{ .ratio = -1, .value = 0.9f }, { 0.5f, 0.5f }, nullptr);
+		for(std::size_t type : layout.slotTypes)
 		{
-			size_t totalCards = gridSize.X() * gridSize.Y();
-			for(size_t i = 0, cardTextureCounter = 0; i < totalCards; i += 2, cardTextureCounter++)
-			{
-				cards.push_back(std::make_unique<Card>(frame, DeluEngine::GUI::RelativeSize{ { 1.f / gridSize.X(), 1.f / gridSize.Y() } }, cardBack, cardFront, textures[cardTextureCounter % textures.size()]));
-				cards.back()->SetParent(gridAligningParent.get());
-				cards.back()->OnClicked() = makeCardsOnClicked(cards.back().get());
-				cards.push_back(std::make_unique<Card>(frame, DeluEngine::GUI::RelativeSize{ { 1.f / gridSize.X(), 1.f / gridSize.Y() } }, cardBack, cardFront, textures[cardTextureCounter % textures.size()]));
-				cards.back()->SetParent(gridAligningParent.get());
-				cards.back()->OnClicked() = makeCardsOnClicked(cards.back().get());
-			}
-		}
-
-		for(auto& card : cards)
-		{
-			std::swap(card, cards[rand() % cards.size()]);
+			cards.push_back(std::make_unique<Card>(frame, DeluEngine::GUI::RelativeSize{ { 1.f / gridSize.X(), 1.f / gridSize.Y() } }, type));
+			cards.back()->SetParent(gridAligningParent.get());
+			cards.back()->OnClicked() = makeCardsOnClicked(cards.back().get());
 		}
 
 		for(size_t y = 0; y < gridSize.Y(); y++)
@@ -255,6 +296,29 @@ public:
 			}
 		}
 
+		//Cards that were matched before a texture arrived are already gone from cards, so only live ones get it
+		cardBackTexture.Then([this](const DeluEngine::AsyncTexture& texture)
+			{
+				for(auto& card : cards)
+					card->backCardButton->SetTexture(texture.Get());
+			});
+		cardFrontTexture.Then([this](const DeluEngine::AsyncTexture& texture)
+			{
+				for(auto& card : cards)
+					card->frontCard->SetTexture(texture.Get());
+			});
+		for(std::size_t type = 0; type < cardTypeTextures.size(); type++)
+		{
+			cardTypeTextures[type].Then([this, type](const DeluEngine::AsyncTexture& texture)
+				{
+					for(auto& card : cards)
+					{
+						if(card->GetType() == type)
+							card->cardTypeIcon->SetTexture(texture.Get());
+					}
+				});
+		}
+
 	}
 
 	~CardGrid()
@@ -280,16 +344,6 @@ public:
 			gameTimeText->SetText(std::format("Time: {}", gameTime));
 		}
 
-		if(selectedCards[0] != nullptr && selectedCards[1] != nullptr)
-		{
-			timer += deltaTime;
-		}
-
-		if(timer >= 1)
-		{
-			CheckMatchingCards();
-		}
-
 		if(!victoryScreen && cards.size() == 0)
 		{
 			victoryScreen = std::make_unique<VictoryScreen>(*engine, engine->guiEngine);
@@ -322,7 +376,7 @@ public:
 			selectedCards[1]->FlipDown();
 		}
 		selectedCards[0] = selectedCards[1] = nullptr;
-		timer = 0;
+		revealTimer.Reset();
 	}
 
 	void OpenPauseMenu()
@@ -342,58 +396,59 @@ public:
 };
 
 
-void CardMatchSceneLoader::operator()(ECS::Scene& s) const
+//Touches no GUI or renderer state, so it can run in a streamed scene's prepare step
+CardMatchLayout PrepareCardMatch(DeluEngine::Engine& engine, xk::Math::Aliases::iVector2 cardCount, unsigned seed)
 {
-	std::cout << "Entered card match scene\n";
-
-	DeluEngine::Engine& engine = DeluEngine::GetEngine(s);
-	DeluEngine::SceneGUISystem& gui = s.GetSystem<DeluEngine::SceneGUISystem>();
-
-	std::array pngSurfaces
+	std::array<std::string, 12> cardPaths
 	{
-		IMG_Load("Cards/delu bonk.png"),
-		IMG_Load("Cards/deluHi.png"),
-		IMG_Load("Cards/deluminlove.png"),
-		IMG_Load("Cards/DeluNG.png"),
-		IMG_Load("Cards/DeluOk.png"),
-		IMG_Load("Cards/delupenlight.png"),
-		IMG_Load("Cards/DeluPog.png"),
-		IMG_Load("Cards/Deluthug.png"),
-		IMG_Load("Cards/deluwu.png"),
-		IMG_Load("Cards/FXtaya.png"),
-		IMG_Load("Cards/piyotaya.png"),
-		IMG_Load("Cards/syobontaya.png"),
+		"Cards/delu bonk.png",
+		"Cards/deluHi.png",
+		"Cards/deluminlove.png",
+		"Cards/DeluNG.png",
+		"Cards/DeluOk.png",
+		"Cards/delupenlight.png",
+		"Cards/DeluPog.png",
+		"Cards/Deluthug.png",
+		"Cards/deluwu.png",
+		"Cards/FXtaya.png",
+		"Cards/piyotaya.png",
+		"Cards/syobontaya.png",
 	};
 
-	std::array<SDL2pp::shared_ptr<SDL2pp::Texture>, pngSurfaces.size()> cardTextures;
-	SDL2pp::shared_ptr<SDL2pp::Texture> cardFrontTexture;
-	SDL2pp::shared_ptr<SDL2pp::Texture> cardBackTexture;
-	for(size_t i = 0; i < pngSurfaces.size(); i++)
-	{
-		cardTextures[i] = engine.renderer.backend->CreateTexture(pngSurfaces[i]);
-	}
+	//Seeded by the caller as rand's state may not be shared with the thread this runs on
+	std::mt19937 random{ seed };
+	std::shuffle(cardPaths.begin(), cardPaths.end(), random);
 
-	for(auto& card : cardTextures)
-	{
-		card.swap(cardTextures[rand() % cardTextures.size()]);
-	}
-	{
-		auto surface = IMG_Load("BlankCard.png");
-		cardFrontTexture = engine.renderer.backend->CreateTexture(surface);
-		SDL_FreeSurface(surface);
-	}
+	CardMatchLayout layout{ .cardCount = cardCount };
+
+	//Decoded on the asset loader's workers, the grid fills textures in as they are uploaded
+	for(const std::string& path : cardPaths)
 	{
-		auto surface = IMG_Load("CardBack.png");
-		cardBackTexture = engine.renderer.backend->CreateTexture(surface);
-		SDL_FreeSurface(surface);
+		layout.cardTypeTextures.push_back(engine.assets.LoadTexture(path));
 	}
+	layout.cardFrontTexture = engine.assets.LoadTexture("BlankCard.png");
+	layout.cardBackTexture = engine.assets.LoadTexture("CardBack.png");
 
-	for(auto surface : pngSurfaces)
+	const std::size_t pairCount = (static_cast<std::size_t>(cardCount.X()) * cardCount.Y() + 1) / 2;
+	for(std::size_t pair = 0; pair < pairCount; pair++)
 	{
-		SDL_FreeSurface(surface);
+		layout.slotTypes.insert(layout.slotTypes.end(), 2, pair % cardPaths.size());
 	}
+	std::shuffle(layout.slotTypes.begin(), layout.slotTypes.end(), random);
+	return layout;
+}
 
-	CardGrid& grid = s.CreateSystem<CardGrid>(engine.guiEngine, cardCount, cardTextures, cardBackTexture, cardFrontTexture);
+void CreateCardMatch(ECS::Scene& s, CardMatchLayout layout)
+{
+	std::cout << "Entered card match scene\n";
+
+	DeluEngine::Engine& engine = DeluEngine::GetEngine(s);
+	s.CreateSystem<CardGrid>(engine.guiEngine, std::move(layout));
+}
+
+void CardMatchSceneLoader::operator()(ECS::Scene& s) const
+{
+	CreateCardMatch(s, PrepareCardMatch(DeluEngine::GetEngine(s), cardCount, static_cast<unsigned>(std::rand())));
 }
 
 export CardMatchSceneLoader CardMatchScene(xk::Math::Aliases::iVector2 cardCount)
@@ -401,6 +456,25 @@ export CardMatchSceneLoader CardMatchScene(xk::Math::Aliases::iVector2 cardCount
 	return CardMatchSceneLoader(cardCount);
 }
 
+export void StreamCardMatchScene(DeluEngine::Engine& engine, xk::Math::Aliases::iVector2 cardCount)
+{
+	//Shared by both steps, prepare fills it in on the thread pool and init hands it to the grid
+	auto layout = std::make_shared<CardMatchLayout>();
+	engine.StreamScene(
+		[&engine, layout, cardCount, seed = static_cast<unsigned>(std::rand())](ECS::Scene&)
+		{
+			*layout = PrepareCardMatch(engine, cardCount, seed);
+		},
+		[layout]
+		{
+			return layout->IsSettled();
+		},
+		[layout](ECS::Scene& s)
+		{
+			CreateCardMatch(s, std::move(*layout));
+		});
+}
+
 using namespace xk::Math::Aliases;
 export auto TitleScene()
 {
@@ -418,7 +492,7 @@ export auto TitleScene()
 		DeluEngine::GUI::Button* quitButton = temp2.get();
 		gui.AddPersistentElement(std::move(temp2));
 		quitButton->debugName = "Two";
-		quitButton->texture = engine.renderer.backend->CreateTexture(quitButtonPNG);
+		quitButton->SetTexture(engine.renderer.backend->CreateTexture(quitButtonPNG));
 		quitButton->SetPivot({ 0.5f, 0.0f });
 		quitButton->SetLocalPosition(DeluEngine::GUI::RelativePosition{ { 0.5f, 0.2f } });
 		quitButton->SetLocalSize(DeluEngine::GUI::AbsoluteSize{ { quitButtonPNG->w, quitButtonPNG->h } });
@@ -434,14 +508,14 @@ export auto TitleScene()
 		gui.AddPersistentElement(std::move(temp2));
 
 		playButton->debugName = "Three";
-		playButton->texture = engine.renderer.backend->CreateTexture(playButtonPNG);
+		playButton->SetTexture(engine.renderer.backend->CreateTexture(playButtonPNG));
 		playButton->SetPivot({ 0.5f, 0.0f });
 		playButton->SetLocalPosition(DeluEngine::GUI::RelativePosition{ { 0.5f, 0.4f } });
 		playButton->SetLocalSize(DeluEngine::GUI::AbsoluteSize{ { playButtonPNG->w, playButtonPNG->h } });
 		playButton->ConvertUnderlyingSizeRepresentation<DeluEngine::GUI::AspectRatioRelativeSize>();
 		playButton->onClicked = [&engine]
 			{
-				engine.queuedScene = CardMatchScene({5, 5});
+				StreamCardMatchScene(engine, { 5, 5 });
 			};
 
 		SDL_FreeSurface(quitButtonPNG);
@@ -5,6 +5,7 @@ module;
 #include <format>
 #include <stdexcept>
 #include <optional>
+#include <span>
 #include "MacroHelpers.h"
 
 export module SDL2pp:Renderer;
@@ -75,6 +76,12 @@ namespace SDL2pp
 			ThrowIfFailed(SDL_SetTextureBlendMode(&Get(), mode));
 		}
 
+		//pixels must be in the texture's format, the whole texture is updated when rect is empty
+		void Update(std::optional<Rect> rect, const void* pixels, int pitch)
+		{
+			ThrowIfFailed(SDL_UpdateTexture(&Get(), rect ? &*rect : nullptr, pixels, pitch));
+		}
+
 		TextureData QueryTexture() const
 		{
 			TextureData data;
@@ -105,7 +112,6 @@ namespace SDL2pp
 	//		SDL_CreateSoftwareRenderer
 	//		SDL_CreateWindowAndRenderer
 	//		SDL_DestroyRenderer
-	//		SDL_GetRenderDrawBlendMode
 	//		SDL_GetRenderDrawColor
 	//		SDL_GetRendererInfo
 	//		SDL_GetRendererOutputSize
@@ -215,11 +221,26 @@ namespace SDL2pp
 			return unique_ptr<Texture>{ ThrowIfNullptr(SDL_CreateTextureFromSurface(&Get(), surface.get()), "Failed to create texture")};
 		}
 
+		void DrawGeometry(view_ptr<Texture> texture, std::span<const Vertex> vertices, std::span<const int> indices)
+		{
+			ThrowIfFailed(SDL_RenderGeometry(&Get(),
+				texture.get(),
+				vertices.data(),
+				static_cast<int>(vertices.size()),
+				indices.empty() ? nullptr : indices.data(),
+				static_cast<int>(indices.size())));
+		}
+
 		void DrawLine(xk::Math::Aliases::Vector2 p1, xk::Math::Aliases::Vector2 p2)
 		{
 			SDL_RenderDrawLineF(&Get(), p1.X(), p1.Y(), p2.X(), p2.Y());
 		}
 
+		void FillRect(std::optional<Rect> rect = std::nullopt)
+		{
+			ThrowIfFailed(SDL_RenderFillRect(&Get(), rect.has_value() ? &rect.value() : static_cast<decltype(rect)::value_type*>(nullptr)));
+		}
+
 		xk::Math::Aliases::iVector2 GetOutputSize() const
 		{
 			xk::Math::Aliases::iVector2 size;
@@ -232,6 +253,18 @@ namespace SDL2pp
 			SDL_RenderPresent(&Get());
 		}
 
+		void SetClipRect(std::optional<Rect> rect)
+		{
+			ThrowIfFailed(SDL_RenderSetClipRect(&Get(), rect.has_value() ? &rect.value() : static_cast<decltype(rect)::value_type*>(nullptr)));
+		}
+
+		SDL_BlendMode GetDrawBlendMode() const
+		{
+			SDL_BlendMode mode;
+			ThrowIfFailed(SDL_GetRenderDrawBlendMode(&Get(), &mode));
+			return mode;
+		}
+
 		void SetDrawBlendMode(SDL_BlendMode mode)
 		{
 			ThrowIfFailed(SDL_SetRenderDrawBlendMode(&Get(), mode));
@@ -266,4 +299,15 @@ namespace SDL2pp
 	{
 		return unique_ptr<Renderer>{ ThrowIfNullptr(SDL_CreateRenderer(window, deviceIndex, static_cast<std::underlying_type_t<RendererFlag>>(flags)), "Failed to create renderer")};
 	}
+
+	//Renders on the CPU into surface, does not need a window or a video driver
+	export unique_ptr<Renderer> CreateSoftwareRenderer(gsl::not_null<Surface*> surface)
+	{
+		return unique_ptr<Renderer>{ ThrowIfNullptr(SDL_CreateSoftwareRenderer(surface), "Failed to create software renderer")};
+	}
+
+	export unique_ptr<Surface> CreateSurface(xk::Math::Aliases::iVector2 size, PixelFormat format)
+	{
+		return unique_ptr<Surface>{ ThrowIfNullptr(SDL_CreateRGBSurfaceWithFormat(0, size.X(), size.Y(), SDL_BITSPERPIXEL(format), format), "Failed to create surface")};
+	}
 }
\ No newline at end of file
@@ -17,6 +17,7 @@ export namespace SDL2pp
 	using FRect = SDL_FRect;
 	using Point = SDL_Point;
 	using FPoint = SDL_FPoint;
+	using Vertex = SDL_Vertex;
 	using RendererFlip = SDL_RendererFlip;
 	using PixelFormat = SDL_PixelFormatEnum;
 	using TextureAccess = SDL_TextureAccess;
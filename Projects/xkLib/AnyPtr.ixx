@@ -1,23 +1,76 @@
 module;
 
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
 #include <typeinfo>
 
 export module xk.AnyPtr;
 
 namespace xk
 {
+	//Mutable so identical code folding (/OPT:ICF) can't merge the tags of different types into one address
+	template<class Ty>
+	struct TypeIdTag
+	{
+		inline static char tag;
+	};
+
+	//Identifies a type without RTTI, comparing two is comparing two addresses
+	//cv qualifiers are ignored the same way typeid ignores them
+	export class TypeId
+	{
+	private:
+		const void* m_id;
+
+		constexpr explicit TypeId(const void* id) noexcept :
+			m_id{ id }
+		{
+
+		}
+
+	public:
+		template<class Ty>
+		static constexpr TypeId Of() noexcept
+		{
+			return TypeId{ &TypeIdTag<std::remove_cv_t<Ty>>::tag };
+		}
+
+		friend constexpr bool operator==(TypeId, TypeId) noexcept = default;
+
+		std::size_t Hash() const noexcept { return std::hash<const void*>{}(m_id); }
+	};
+
+	//Numbers types densely from 0 in the order they are first asked for, separately for each Family
+	//Meant for indexing arrays by type, unlike TypeId the numbers can differ between runs
+	export template<class Family>
+	class TypeIndex
+	{
+	private:
+		inline static std::atomic<std::size_t> s_next{ 0 };
+
+	public:
+		template<class Ty>
+		static std::size_t Of() noexcept
+		{
+			static const std::size_t index = s_next++;
+			return index;
+		}
+	};
+
 	export class AnyPtr
 	{
 	private:
 		void* m_ptr = nullptr;
-		const std::type_info* m_type = nullptr;
+		TypeId m_type = TypeId::Of<void>();
 
 	public:
 		AnyPtr() noexcept = default;
 		template<class Ty>
 		AnyPtr(Ty* ptr) noexcept :
 			m_ptr{ ptr },
-			m_type{ ptr ? &typeid(Ty) : nullptr }
+			m_type{ ptr ? TypeId::Of<Ty>() : TypeId::Of<void>() }
 		{
 
 		}
@@ -26,14 +79,14 @@ namespace xk
 		AnyPtr& operator=(Ty* ptr) noexcept
 		{
 			m_ptr = ptr;
-			m_type = ptr ? &typeid(Ty) : nullptr;
+			m_type = ptr ? TypeId::Of<Ty>() : TypeId::Of<void>();
 			return *this;
 		}
 
 		template<class Ty>
 		bool Is() const noexcept
 		{
-			return m_type && typeid(Ty) == *m_type;
+			return m_ptr && TypeId::Of<Ty>() == m_type;
 		}
 
 		template<class Ty>
@@ -51,7 +104,7 @@ namespace xk
 	{
 	private:
 		void* m_ptr = nullptr;
-		const std::type_info* m_type = nullptr;
+		TypeId m_type;
 
 	public:
 		AnyRef() noexcept = delete;
@@ -59,7 +112,7 @@ namespace xk
 		template<class Ty>
 		AnyRef(Ty& ptr) noexcept :
 			m_ptr{ &ptr },
-			m_type{ &typeid(Ty) }
+			m_type{ TypeId::Of<Ty>() }
 		{
 
 		}
@@ -67,7 +120,7 @@ namespace xk
 		template<class Ty>
 		bool Is() const noexcept
 		{
-			return m_type && typeid(Ty) == *m_type;
+			return TypeId::Of<Ty>() == m_type;
 		}
 
 		template<class Ty>
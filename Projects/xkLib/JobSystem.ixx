@@ -0,0 +1,202 @@
+module;
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+export module xk.JobSystem;
+
+namespace xk
+{
+	export class JobSystem;
+
+	//Tracks jobs started with it, the first exception a job throws is rethrown by JobSystem::Wait
+	export class JobCounter
+	{
+		friend class JobSystem;
+
+	private:
+		std::atomic<std::size_t> m_pending{ 0 };
+		std::mutex m_errorMutex;
+		std::exception_ptr m_error;
+
+	public:
+		JobCounter() = default;
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		bool IsDone() const noexcept { return m_pending.load(std::memory_order_acquire) == 0; }
+	};
+
+	//Worker threads with a job deque each, idle workers steal the oldest jobs from the others
+	//Waiting runs queued jobs instead of blocking, so jobs can start and wait on jobs of their own
+	export class JobSystem
+	{
+	private:
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()>> jobs;
+		};
+
+		//One per worker plus a last one shared by every thread outside the system
+		std::vector<std::unique_ptr<Queue>> m_queues;
+		std::atomic<std::size_t> m_queuedJobs{ 0 };
+		std::mutex m_sleepMutex;
+		std::condition_variable_any m_jobAvailable;
+		std::vector<std::jthread> m_workers;
+
+		inline static thread_local const JobSystem* t_owner = nullptr;
+		inline static thread_local std::size_t t_queueIndex = 0;
+
+	public:
+		//Leaves one hardware thread for the thread that owns the system, hardware_concurrency is 0 when unknown
+		JobSystem() :
+			JobSystem(std::max(2u, std::thread::hardware_concurrency()) - 1)
+		{
+
+		}
+
+		explicit JobSystem(std::size_t threadCount)
+		{
+			m_queues.reserve(threadCount + 1);
+			for(std::size_t i = 0; i < threadCount + 1; i++)
+			{
+				m_queues.push_back(std::make_unique<Queue>());
+			}
+
+			m_workers.reserve(threadCount);
+			for(std::size_t i = 0; i < threadCount; i++)
+			{
+				m_workers.emplace_back([this, i](std::stop_token stopToken) { WorkerMain(stopToken, i); });
+			}
+		}
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		//Jobs still queued are dropped, running jobs are joined
+		~JobSystem()
+		{
+			for(std::jthread& worker : m_workers)
+			{
+				worker.request_stop();
+			}
+			m_workers.clear();
+		}
+
+		std::size_t GetThreadCount() const noexcept { return m_workers.size(); }
+
+		void Run(JobCounter& counter, std::function<void()> job)
+		{
+			counter.m_pending.fetch_add(1, std::memory_order_relaxed);
+			Push([&counter, job = std::move(job)]
+				{
+					try
+					{
+						job();
+					}
+					catch(...)
+					{
+						std::scoped_lock lock{ counter.m_errorMutex };
+						if(!counter.m_error)
+							counter.m_error = std::current_exception();
+					}
+					counter.m_pending.fetch_sub(1, std::memory_order_release);
+				});
+		}
+
+		void Wait(JobCounter& counter)
+		{
+			while(!counter.IsDone())
+			{
+				if(!TryRunJob())
+					std::this_thread::yield();
+			}
+
+			std::scoped_lock lock{ counter.m_errorMutex };
+			if(counter.m_error)
+				std::rethrow_exception(std::exchange(counter.m_error, nullptr));
+		}
+
+	private:
+		std::size_t GetLocalQueue() const noexcept
+		{
+			return t_owner == this ? t_queueIndex : m_queues.size() - 1;
+		}
+
+		void Push(std::function<void()> job)
+		{
+			Queue& queue = *m_queues[GetLocalQueue()];
+			{
+				std::scoped_lock lock{ queue.mutex };
+				queue.jobs.push_back(std::move(job));
+			}
+			m_queuedJobs.fetch_add(1, std::memory_order_release);
+
+			//Taking the lock orders this with a worker that has checked for jobs but not started waiting yet
+			{
+				std::scoped_lock lock{ m_sleepMutex };
+			}
+			m_jobAvailable.notify_one();
+		}
+
+		//Newest local job first as its data is likely still cached, oldest from others as it tends to be the largest
+		bool TryRunJob()
+		{
+			std::function<void()> job;
+			const std::size_t local = GetLocalQueue();
+			{
+				Queue& queue = *m_queues[local];
+				std::scoped_lock lock{ queue.mutex };
+				if(!queue.jobs.empty())
+				{
+					job = std::move(queue.jobs.back());
+					queue.jobs.pop_back();
+				}
+			}
+
+			for(std::size_t i = 1; !job && i < m_queues.size(); i++)
+			{
+				Queue& victim = *m_queues[(local + i) % m_queues.size()];
+				std::scoped_lock lock{ victim.mutex };
+				if(!victim.jobs.empty())
+				{
+					job = std::move(victim.jobs.front());
+					victim.jobs.pop_front();
+				}
+			}
+
+			if(!job)
+				return false;
+
+			m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			job();
+			return true;
+		}
+
+		void WorkerMain(std::stop_token stopToken, std::size_t queueIndex)
+		{
+			t_owner = this;
+			t_queueIndex = queueIndex;
+			while(!stopToken.stop_requested())
+			{
+				if(TryRunJob())
+					continue;
+
+				std::unique_lock lock{ m_sleepMutex };
+				m_jobAvailable.wait(lock, stopToken, [this] { return m_queuedJobs.load(std::memory_order_acquire) > 0; });
+			}
+		}
+	};
+}
@@ -0,0 +1,258 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module xk.Profiler;
+
+namespace xk
+{
+	//Define XK_DISABLE_PROFILER to compile every zone down to nothing, zones are declared with XK_PROFILE_ZONE from ProfilerMacros.h
+#ifdef XK_DISABLE_PROFILER
+	export inline constexpr bool profilerEnabled = false;
+#else
+	export inline constexpr bool profilerEnabled = true;
+#endif
+
+	//Ring of the most recent zones finished on one thread
+	//Only the owning thread writes so recording never takes a lock, older zones are overwritten once it is full
+	class ProfileBuffer
+	{
+	public:
+		struct Zone
+		{
+			const char* name;
+			std::int64_t start;
+			std::int64_t end;
+		};
+
+		static constexpr std::size_t capacity = 1 << 14;
+
+	private:
+		std::array<Zone, capacity> m_zones;
+		std::atomic<std::uint64_t> m_written{ 0 };
+		std::uint32_t m_threadId;
+
+	public:
+		explicit ProfileBuffer(std::uint32_t threadId) :
+			m_threadId{ threadId }
+		{
+
+		}
+
+		std::uint32_t GetThreadId() const noexcept { return m_threadId; }
+
+		void Push(const Zone& zone) noexcept
+		{
+			const std::uint64_t index = m_written.load(std::memory_order_relaxed);
+			m_zones[index % capacity] = zone;
+			m_written.store(index + 1, std::memory_order_release);
+		}
+
+		//Copies what was written without stopping the owner
+		//Zones the owner may have been overwriting during the copy are dropped rather than returned torn
+		void Snapshot(std::vector<Zone>& out) const
+		{
+			const std::uint64_t end = m_written.load(std::memory_order_acquire);
+			const std::uint64_t begin = end > capacity ? end - capacity : 0;
+			const std::size_t first = out.size();
+			for(std::uint64_t i = begin; i < end; i++)
+			{
+				out.push_back(m_zones[i % capacity]);
+			}
+
+			const std::uint64_t after = m_written.load(std::memory_order_acquire);
+			if(after + 1 > capacity + begin)
+			{
+				const std::uint64_t overwritten = std::min(after + 1 - capacity - begin, end - begin);
+				out.erase(out.begin() + first, out.begin() + first + overwritten);
+			}
+		}
+	};
+
+	//Collects timed zones from every thread and writes them out as Chrome trace JSON
+	//Load the file in chrome://tracing or ui.perfetto.dev
+	export class Profiler
+	{
+	private:
+		using clock = std::chrono::steady_clock;
+
+		std::mutex m_buffersMutex;
+		std::vector<std::unique_ptr<ProfileBuffer>> m_buffers;
+		std::uint32_t m_nextThreadId = 0;
+		const clock::time_point m_epoch = clock::now();
+		clock::time_point m_frameStart = m_epoch;
+
+		std::chrono::nanoseconds m_spikeThreshold{ 0 };
+		std::filesystem::path m_spikePath;
+
+		//Shared by every instance, zones are meant to go to gProfiler only
+		inline static thread_local ProfileBuffer* t_buffer = nullptr;
+
+		//Frees the thread's buffer when the thread exits, its zones are dropped from later traces
+		struct ThreadRegistration
+		{
+			Profiler* profiler;
+			ProfileBuffer* buffer;
+
+			~ThreadRegistration()
+			{
+				t_buffer = nullptr;
+				profiler->UnregisterThread(buffer);
+			}
+		};
+
+	public:
+		Profiler() = default;
+		Profiler(const Profiler&) = delete;
+		Profiler& operator=(const Profiler&) = delete;
+
+		//name must outlive the profiler, it is only read when writing a trace
+		void Record(const char* name, clock::time_point start, clock::time_point end) noexcept
+		{
+			if constexpr(!profilerEnabled)
+				return;
+
+			if(!t_buffer)
+				t_buffer = RegisterThread();
+			t_buffer->Push({ name, ToNanoseconds(start), ToNanoseconds(end) });
+		}
+
+		//Records the time since the last call as a frame and dumps a trace if it took longer than the spike threshold
+		void EndFrame()
+		{
+			if constexpr(!profilerEnabled)
+				return;
+
+			const clock::time_point now = clock::now();
+			Record("Frame", m_frameStart, now);
+			if(m_spikeThreshold.count() > 0 && now - m_frameStart > m_spikeThreshold)
+			{
+				//One shot so a run of slow frames doesn't turn into a run of trace writes
+				m_spikeThreshold = std::chrono::nanoseconds{ 0 };
+				WriteChromeTrace(m_spikePath);
+			}
+			m_frameStart = now;
+		}
+
+		//Arms a single trace dump for the next frame that takes longer than threshold
+		void SetSpikeDump(std::chrono::nanoseconds threshold, std::filesystem::path path)
+		{
+			m_spikeThreshold = threshold;
+			m_spikePath = std::move(path);
+		}
+
+		void WriteChromeTrace(const std::filesystem::path& path)
+		{
+			std::ofstream file{ path };
+			if(!file)
+				throw std::runtime_error("Failed to open " + path.string() + " for writing");
+			WriteChromeTrace(file);
+		}
+
+		void WriteChromeTrace(std::ostream& stream)
+		{
+			std::vector<ProfileBuffer::Zone> zones;
+			stream << "{\"traceEvents\":[";
+			bool first = true;
+
+			std::scoped_lock lock{ m_buffersMutex };
+			for(const std::unique_ptr<ProfileBuffer>& buffer : m_buffers)
+			{
+				zones.clear();
+				buffer->Snapshot(zones);
+				for(const ProfileBuffer::Zone& zone : zones)
+				{
+					if(!std::exchange(first, false))
+						stream << ',';
+
+					stream << "\n{\"name\":\"";
+					WriteEscaped(stream, zone.name);
+					stream << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->GetThreadId()
+						<< std::fixed << std::setprecision(3)
+						<< ",\"ts\":" << zone.start / 1000.0
+						<< ",\"dur\":" << (zone.end - zone.start) / 1000.0 << '}';
+				}
+			}
+			stream << "\n]}\n";
+		}
+
+	private:
+		std::int64_t ToNanoseconds(clock::time_point time) const noexcept
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(time - m_epoch).count();
+		}
+
+		ProfileBuffer* RegisterThread()
+		{
+			ProfileBuffer* buffer;
+			{
+				std::scoped_lock lock{ m_buffersMutex };
+				buffer = m_buffers.emplace_back(std::make_unique<ProfileBuffer>(m_nextThreadId++)).get();
+			}
+
+			//Constructed once per thread, on its first zone
+			thread_local ThreadRegistration registration{ this, buffer };
+			return buffer;
+		}
+
+		void UnregisterThread(ProfileBuffer* buffer) noexcept
+		{
+			std::scoped_lock lock{ m_buffersMutex };
+			std::erase_if(m_buffers, [buffer](const std::unique_ptr<ProfileBuffer>& owned) { return owned.get() == buffer; });
+		}
+
+		static void WriteEscaped(std::ostream& stream, std::string_view text)
+		{
+			for(char c : text)
+			{
+				if(c == '"' || c == '\\')
+					stream << '\\' << c;
+				else if(static_cast<unsigned char>(c) < 0x20)
+					stream << ' ';
+				else
+					stream << c;
+			}
+		}
+	};
+
+	export Profiler gProfiler;
+
+	//Times the scope it is declared in, declare it through XK_PROFILE_ZONE so a disabled profiler doesn't evaluate the name either
+	export class ProfileZone
+	{
+	private:
+		const char* m_name;
+		std::chrono::steady_clock::time_point m_start;
+
+	public:
+		explicit ProfileZone(const char* name) noexcept :
+			m_name{ name }
+		{
+			if constexpr(profilerEnabled)
+				m_start = std::chrono::steady_clock::now();
+		}
+
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone& operator=(const ProfileZone&) = delete;
+
+		~ProfileZone()
+		{
+			if constexpr(profilerEnabled)
+				gProfiler.Record(m_name, m_start, std::chrono::steady_clock::now());
+		}
+	};
+}
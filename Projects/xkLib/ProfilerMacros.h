@@ -0,0 +1,12 @@
+#pragma once
+
+#define XK_PROFILE_CONCAT_IMPL(lh, rh) lh##rh
+#define XK_PROFILE_CONCAT(lh, rh) XK_PROFILE_CONCAT_IMPL(lh, rh)
+
+//Times the rest of the enclosing scope as a zone of xk::gProfiler, name must outlive the profiler
+//Defining XK_DISABLE_PROFILER compiles the zone out along with the expression naming it
+#ifdef XK_DISABLE_PROFILER
+#define XK_PROFILE_ZONE(name) static_cast<void>(0)
+#else
+#define XK_PROFILE_ZONE(name) ::xk::ProfileZone XK_PROFILE_CONCAT(xkProfileZone, __LINE__){ name }
+#endif
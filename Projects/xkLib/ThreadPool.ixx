@@ -0,0 +1,110 @@
+module;
+
+#include <algorithm>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+export module xk.ThreadPool;
+
+namespace xk
+{
+	//Fixed set of worker threads pulling from one shared FIFO queue
+	//Destroying the pool runs every task still queued, including ones those tasks post, before joining
+	export class ThreadPool
+	{
+	private:
+		std::mutex m_mutex;
+		std::condition_variable_any m_taskAvailable;
+		std::deque<std::function<void()>> m_tasks;
+		std::vector<std::jthread> m_workers;
+
+	public:
+		//Leaves one hardware thread for the thread that owns the pool, hardware_concurrency is 0 when unknown
+		ThreadPool() :
+			ThreadPool(std::max(2u, std::thread::hardware_concurrency()) - 1)
+		{
+
+		}
+
+		explicit ThreadPool(std::size_t threadCount)
+		{
+			m_workers.reserve(threadCount);
+			for(std::size_t i = 0; i < threadCount; i++)
+			{
+				m_workers.emplace_back([this](std::stop_token stopToken) { WorkerMain(stopToken); });
+			}
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		~ThreadPool()
+		{
+			for(std::jthread& worker : m_workers)
+			{
+				worker.request_stop();
+			}
+			m_workers.clear();
+
+			//A pool without workers still owes its tasks a run
+			while(!m_tasks.empty())
+			{
+				std::function<void()> task = std::move(m_tasks.front());
+				m_tasks.pop_front();
+				task();
+			}
+		}
+
+		std::size_t GetThreadCount() const noexcept { return m_workers.size(); }
+
+		//Fire and forget, exceptions escaping task terminate the program
+		void Post(std::function<void()> task)
+		{
+			{
+				std::scoped_lock lock{ m_mutex };
+				m_tasks.push_back(std::move(task));
+			}
+			m_taskAvailable.notify_one();
+		}
+
+		template<std::invocable<> Func>
+		auto Submit(Func&& func) -> std::future<std::invoke_result_t<Func>>
+		{
+			//std::function needs a copyable target, packaged_task isn't
+			auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Func>()>>(std::forward<Func>(func));
+			std::future<std::invoke_result_t<Func>> future = task->get_future();
+			Post([task] { (*task)(); });
+			return future;
+		}
+
+	private:
+		void WorkerMain(std::stop_token stopToken)
+		{
+			while(true)
+			{
+				std::function<void()> task;
+				{
+					std::unique_lock lock{ m_mutex };
+					//Only stops once the queue is drained
+					m_taskAvailable.wait(lock, stopToken, [this] { return !m_tasks.empty(); });
+					if(m_tasks.empty())
+						return;
+
+					task = std::move(m_tasks.front());
+					m_tasks.pop_front();
+				}
+				task();
+			}
+		}
+	};
+}
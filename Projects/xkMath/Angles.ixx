@@ -1,7 +1,8 @@
 module;
 
+#include <compare>
+
 export module xk.Math.Angles;
-export import <compare>;
 
 namespace xk::Math
 {
@@ -8,7 +8,9 @@ module;
 #include <cmath>
 #include <functional>
 
+#ifdef _MSC_VER
 #pragma warning(disable:4244)
+#endif
 export module xk.Math.Matrix;
 
 namespace xk::Math
@@ -320,8 +322,8 @@ namespace xk::Math
 			return lh += rh;
 		}
 
-		template<class Ty2, size_t ElementCount>
-		constexpr Vector& operator-=(const Matrix<Ty2, ElementCount, 1>& rh)
+		template<class Ty2, size_t ElementCount2>
+		constexpr Vector& operator-=(const Matrix<Ty2, ElementCount2, 1>& rh)
 		{
 			static_cast<base_type&>(*this) -= rh;
 			return *this;
@@ -518,4 +520,6 @@ namespace xk::Math
 	}
 }
 
-#pragma warning(default:4244)
\ No newline at end of file
+#ifdef _MSC_VER
+#pragma warning(default:4244)
+#endif